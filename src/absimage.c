@@ -0,0 +1,276 @@
+/**
+ *  @package   fatedit
+ *  @file      absimage.c
+ *  @brief     Access to the sectors of raw disk image files
+ *             ( instead of MSDOS drives ) for a FAT12 and FAT16 disk editor
+ *  @author    Rolf Hemmerling <hemmerling@gmx.net>
+ *  @version   1.00,
+ *             programming language "C",
+ *             development tool chain "Microsoft Visual C++ 1.52" ( Large Model )
+ *             or any Unix "C" compiler,
+ *             target: IBM-PC with MS-DOS operating system, or Unix host
+ *  @date      2015-01-01
+ *  @copyright Apache License, Version 2.0
+ *
+ *  absimage.c - Access to the sectors of raw disk image files
+ *               for a FAT12 and FAT16 disk editor
+ *
+ *  Copyright 1988-2015 Rolf Hemmerling
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing,
+ *  software distributed under the License is distributed on an
+ *  "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ *  either express or implied.
+ *  See the License for the specific language governing permissions
+ *  and limitations under the License.
+ *
+ *  Replaces absdisk.asm, if IMGDISK is defined.
+ *  With a Unix host, the image file is mapped into memory,
+ *  so the bootsector, the FATs, the directory and the viewed clusters
+ *  are accessed within the mapping, without copying:
+ *    cc -o fatedit fatedit.c absimage.c
+ *  With MSDOS, the image file is read and written by stdio functions.
+ */
+
+#ifdef __unix__
+/* 64-bit file offsets, for large harddisk images */
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include "fatedit.h"
+
+#ifdef IMGDISK
+#ifdef __unix__
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+
+/**
+ *  @var      images
+ *  @brief    Raw disk image files of the drives <A:>...<Z:>
+ */
+struct image_tp images[MAXDRIVES];
+
+/**
+ *  @var      images_init
+ *  @brief    After the initialisation of "images", it is set to "true"
+ */
+int images_init = 0;
+
+struct image_tp *get_image(drive)
+ int drive;
+ { int i;
+   if (!images_init)
+    { for (i = 0;i < MAXDRIVES;i++)
+       { images[i].name[0] = '\0';
+#ifdef __unix__
+         images[i].fd = -1;
+         images[i].base = NULL;
+#else
+         images[i].fp = NULL;
+#endif
+       };
+      images_init = !0;
+    };
+   if ((drive < 0) || (drive >= MAXDRIVES) || (images[drive].name[0] == '\0'))
+    { return(NULL);
+    };
+   return(&images[drive]);
+ }
+
+void absclose(drive)
+ int drive;
+ { struct image_tp *img;
+   if ((img = get_image(drive)) == NULL)
+    { return;
+    };
+#ifdef __unix__
+   if (img->base != NULL)
+    { munmap(img->base,(size_t)img->size);
+      img->base = NULL;
+    };
+   close(img->fd);
+   img->fd = -1;
+#else
+   fclose(img->fp);
+   img->fp = NULL;
+#endif
+   img->name[0] = '\0';
+ }
+
+int absopen(drive,filename)
+ int drive;
+ char *filename;
+ { struct image_tp *img;
+   unsigned char bpb[NORMSECSIZE];
+#ifdef __unix__
+   struct stat st;
+#endif
+   absclose(drive);
+   if ((drive < 0) || (drive >= MAXDRIVES) || (strlen(filename) >= IMGNAMELEN))
+    { return(-1);
+    };
+   img = &images[drive];
+#ifdef __unix__
+   if ((img->fd = open(filename,O_RDWR)) < 0)
+    { /* write protected image file, "abswrite" will fail */
+      img->fd = open(filename,O_RDONLY);
+    };
+   if (img->fd < 0)
+    { return(-1);
+    };
+   if ((fstat(img->fd,&st) != 0) || (st.st_size < NORMSECSIZE))
+    { close(img->fd); img->fd = -1;
+      return(-1);
+    };
+   img->size = (long)st.st_size;
+   /* private mapping: changes within the mapping
+      don't reach the image file before "abswrite" */
+   img->base = mmap(NULL,(size_t)img->size,PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE,img->fd,0);
+   if (img->base == MAP_FAILED)
+    { img->base = NULL;
+      close(img->fd); img->fd = -1;
+      return(-1);
+    };
+   memcpy(bpb,img->base,NORMSECSIZE);
+#else
+   if ((img->fp = fopen(filename,"r+b")) == NULL)
+    { img->fp = fopen(filename,"rb");
+    };
+   if (img->fp == NULL)
+    { return(-1);
+    };
+   fseek(img->fp,0L,SEEK_END);
+   img->size = ftell(img->fp);
+   fseek(img->fp,0L,SEEK_SET);
+   if ((img->size < NORMSECSIZE) ||
+       (fread(bpb,NORMSECSIZE,1,img->fp) != 1))
+    { fclose(img->fp); img->fp = NULL;
+      return(-1);
+    };
+#endif
+   /* bytes per sector of the bootsector infoblock */
+   img->secsize = (unsigned int)bpb[11] + ((unsigned int)bpb[12] << 8);
+   if ((img->secsize < MINSECSIZE) || (img->secsize > MAXSECSIZE))
+    { img->secsize = NORMSECSIZE;
+    };
+   strcpy(img->name,filename);
+   return(0);
+ }
+
+void *absmap(drive,nsects,lsect)
+ int drive,nsects;
+ sector_tp lsect;
+ { struct image_tp *img;
+   long offset;
+   if ((img = get_image(drive)) == NULL)
+    { return(NULL);
+    };
+   offset = (long)lsect * img->secsize;
+   if ((lsect < 0) || (nsects < 0) ||
+       (offset + (long)nsects * img->secsize > img->size))
+    { return(NULL);
+    };
+#ifdef __unix__
+   return((void *)(img->base + offset));
+#else
+   return(NULL);
+#endif
+ }
+
+int absread(drive,nsects,lsect,buffer)
+ int drive,nsects;
+ sector_tp lsect;
+ void *buffer;
+ { struct image_tp *img;
+   long offset,length;
+   if ((img = get_image(drive)) == NULL)
+    { return(-1);
+    };
+   offset = (long)lsect * img->secsize;
+   length = (long)nsects * img->secsize;
+   if ((lsect < 0) || (nsects < 0) || (offset + length > img->size))
+    { return(-1);
+    };
+#ifdef __unix__
+   /* always from the file: the mapping is private, so a buffer within
+      the mapping may hold edits, which are discarded by reading again */
+   if (pread(img->fd,buffer,(size_t)length,(off_t)offset) != (ssize_t)length)
+    { return(-1);
+    };
+#else
+   if ((fseek(img->fp,offset,SEEK_SET) != 0) ||
+       (fread(buffer,(size_t)length,1,img->fp) != 1))
+    { return(-1);
+    };
+#endif
+   return(0);
+ }
+
+int abswrite(drive,nsects,lsect,buffer)
+ int drive,nsects;
+ sector_tp lsect;
+ void *buffer;
+ { struct image_tp *img;
+   long offset,length;
+   if ((img = get_image(drive)) == NULL)
+    { return(-1);
+    };
+   offset = (long)lsect * img->secsize;
+   length = (long)nsects * img->secsize;
+   if ((lsect < 0) || (nsects < 0) || (offset + length > img->size))
+    { return(-1);
+    };
+#ifdef __unix__
+   if (pwrite(img->fd,buffer,(size_t)length,(off_t)offset) != (ssize_t)length)
+    { return(-1);
+    };
+   /* a buffer outside of the mapping must update the mapping too */
+   if ((unsigned char *)buffer != img->base + offset)
+    { memcpy(img->base + offset,buffer,(size_t)length);
+    };
+#else
+   if ((fseek(img->fp,offset,SEEK_SET) != 0) ||
+       (fwrite(buffer,(size_t)length,1,img->fp) != 1))
+    { return(-1);
+    };
+   fflush(img->fp);
+#endif
+   return(0);
+ }
+
+#ifdef __unix__
+int getch()
+ { struct termios oldt,newt;
+   int c;
+   /* single keystroke, without echo, like the MSDOS function */
+   if (tcgetattr(0,&oldt) != 0)
+    { return(getchar());
+    };
+   newt = oldt;
+   newt.c_lflag &= ~(ICANON | ECHO);
+   tcsetattr(0,TCSANOW,&newt);
+   c = getchar();
+   tcsetattr(0,TCSANOW,&oldt);
+   return(c);
+ }
+
+void strupr(s)
+ char *s;
+ { for (;*s != '\0';s++)
+    { *s = (char)toupper(*s);
+    };
+ }
+#endif
+#endif
@@ -131,6 +131,35 @@ fatsec_tp *fatptr = NULL;
  */
 unsigned char *viptr = NULL;
 
+#ifdef IMGDISK
+/** 
+ *  @var      map_dir
+ *  @brief    If "true", the main directory is not allocated,
+ *            but "dirptr" points into the mapping of the image file
+ */
+int map_dir = 0;
+
+/** 
+ *  @var      map_fat
+ *  @brief    If "true", the FATs are not allocated,
+ *            but "fatptr" points into the mapping of the image file
+ */
+int map_fat = 0;
+#endif
+
+/** 
+ *  @var      fatpaged
+ *  @brief    If "true", the FATs are neither allocated nor mapped,
+ *            but read in windows of FATWINDOW sectors by the sector cache
+ */
+int fatpaged = 0;
+
+/** 
+ *  @var      fatwindow
+ *  @brief    Buffer for one window of FAT sectors
+ */
+unsigned char *fatwindow = NULL;
+
 /** 
  *  @var      drive
  *  @brief    Default drive, which shall be processed
@@ -197,13 +226,314 @@ int st_fat_entry = 0;
  */
 int st_fat_value = 0;
 
+/* FAT32 main directory */
+
+/** 
+ *  @var      rootclusters
+ *  @brief    FAT32: Clusters of the main directory
+ */
+unsigned int *rootclusters = NULL;
+
+/** 
+ *  @var      rootentries
+ *  @brief    FAT32: Number of entries of the main directory
+ */
+int rootentries = 0;
+
+/* Modified sectors */
+
+/** 
+ *  @var      fatdirty
+ *  @brief    Bitmap of the modified sectors of all FATs
+ */
+unsigned char *fatdirty = NULL;
+
+/** 
+ *  @var      dirdirty
+ *  @brief    Bitmap of the modified sectors of the main directory
+ */
+unsigned char *dirdirty = NULL;
+
+/** 
+ *  @var      bootdirty
+ *  @brief    If "true", the bootsector is modified
+ */
+int bootdirty = 0;
+
+#ifdef FATSHADOW
+/* Decoded work FAT */
+
+/** 
+ *  @var      fatshadow
+ *  @brief    Decoded entries of the work FAT, one per cluster
+ */
+unsigned int *fatshadow = NULL;
+
+/** 
+ *  @var      shadowdirty
+ *  @brief    Bitmap of the entries of "fatshadow", 
+ *            which are not yet entered into the work FAT
+ */
+unsigned char *shadowdirty = NULL;
+#endif
+
+/* Free space index */
+
+/** 
+ *  @var      freemap
+ *  @brief    Bitmap of the free clusters, FREEBITS clusters per word
+ */
+unsigned int *freemap = NULL;
+
+/** 
+ *  @var      freeleaves
+ *  @brief    Number of words of "freemap", a power of 2
+ */
+unsigned int freeleaves = 0;
+
+/** 
+ *  @var      freecnt
+ *  @brief    Segment tree over "freemap": number of free clusters
+ */
+unsigned int *freecnt = NULL;
+
+/** 
+ *  @var      freepre
+ *  @brief    Segment tree over "freemap": free run at the start
+ */
+unsigned int *freepre = NULL;
+
+/** 
+ *  @var      freesuf
+ *  @brief    Segment tree over "freemap": free run at the end
+ */
+unsigned int *freesuf = NULL;
+
+/** 
+ *  @var      freemax
+ *  @brief    Segment tree over "freemap": longest free run
+ */
+unsigned int *freemax = NULL;
+
+/* Cluster owner index */
+
+/** 
+ *  @var      ownerdir
+ *  @brief    For each cluster the main directory entry, 
+ *            which chain reaches the cluster first, NOOWNER = none
+ */
+int *ownerdir = NULL;
+
+/** 
+ *  @var      ownerpos
+ *  @brief    For each cluster the position within the chain of "ownerdir",
+ *            0 = startcluster
+ */
+unsigned int *ownerpos = NULL;
+
+/** 
+ *  @var      ownerstart
+ *  @brief    For each main directory entry the startcluster, 
+ *            by which its chain was entered into "ownerdir"
+ */
+unsigned int *ownerstart = NULL;
+
+/** 
+ *  @var      ownerdirs
+ *  @brief    Number of entries of "ownerstart"
+ */
+int ownerdirs = 0;
+
+/** 
+ *  @var      crossmap
+ *  @brief    Bitmap of the clusters of "ownerdir", at which the chain
+ *            of another directory entry ends ( cross-linked )
+ */
+unsigned char *crossmap = NULL;
+
+/* Cluster contents */
+
+/** 
+ *  @var      classmap
+ *  @brief    Class of the contents of each cluster, CLUNKNOWN...CLBINARY,
+ *            2 clusters per byte
+ */
+unsigned char *classmap = NULL;
+
+/** 
+ *  @var      classcnt
+ *  @brief    Number of clusters of each class of "classmap"
+ */
+unsigned int classcnt[CLASSES];
+
+/** 
+ *  @var      classnames
+ *  @brief    Names of the classes of "classmap"
+ */
+char *classnames[CLASSES] =
+ { "unknown", "zero", "formatted (F6)", "text", "binary" };
+
+/** 
+ *  @var      carvesigs
+ *  @brief    Headers of the binary files found by carving
+ */
+struct carvesig_tp carvesigs[CARVESIGS] =
+ { { "EXE",  "EXE", { 'M', 'Z' }, 2, CVEXE },
+   { "ZIP",  "ZIP", { 'P', 'K', 0x03, 0x04 }, 4, CVZIP },
+   { "ARC",  "ARC", { 0x1A }, 1, CVARC },
+   { "GIF",  "GIF", { 'G', 'I', 'F', '8' }, 4, CVGIF },
+   { "BMP",  "BMP", { 'B', 'M' }, 2, CVBMP },
+   { "JPEG", "JPG", { 0xFF, 0xD8, 0xFF }, 3, CVJPEG }
+ };
+
+/** 
+ *  @var      textinfo
+ *  @brief    Features of the start and the end of each text cluster,
+ *            sorted by the cluster
+ */
+struct textinfo_tp *textinfo = NULL;
+
+/** 
+ *  @var      ntext
+ *  @brief    Number of text clusters of "textinfo"
+ */
+unsigned int ntext = 0;
+
+/** 
+ *  @var      suggest
+ *  @brief    The SUGGESTK most likely next clusters of each text cluster
+ *            of "textinfo", NOFAT = none
+ */
+unsigned int *suggest = NULL;
+
+/** 
+ *  @var      suggestscore
+ *  @brief    Score of each cluster of "suggest"
+ */
+int *suggestscore = NULL;
+
+/** 
+ *  @var      gramtab
+ *  @brief    How often each hashed triple of bytes is found
+ *            within the text clusters
+ */
+unsigned int *gramtab = NULL;
+
+/** 
+ *  @var      gramtotal
+ *  @brief    Number of the triples of bytes of "gramtab"
+ */
+unsigned long gramtotal = 0;
+
+/** 
+ *  @var      gramavg
+ *  @brief    Average count of "gramtab"
+ */
+unsigned int gramavg = 0;
+
+/* Directory tree */
+
+/** 
+ *  @var      dirtree
+ *  @brief    Nodes of the directory tree, breadth first,
+ *            node MAINNODE is the main directory
+ */
+struct dirnode_tp *dirtree = NULL;
+
+/** 
+ *  @var      ndirnodes
+ *  @brief    Number of nodes of "dirtree", 0 if it is not loaded
+ */
+int ndirnodes = 0;
+
+/** 
+ *  @var      dir_node
+ *  @brief    Directory of the direntry menu, a node of "dirtree"
+ */
+int dir_node = MAINNODE;
+
+/** 
+ *  @var      node_entry
+ *  @brief    Selected directory entry of a subdirectory,
+ *            "dir_entry" stays the one of the main directory
+ */
+unsigned int node_entry = 0;
+
+/* Sector cache */
+
+/** 
+ *  @var      cache
+ *  @brief    Slots of the sector cache
+ */
+struct cacheslot_tp *cache = NULL;
+
+/** 
+ *  @var      cachedata
+ *  @brief    Sectors of the sector cache, one per slot
+ */
+unsigned char *cachedata = NULL;
+
+/** 
+ *  @var      cachehash
+ *  @brief    First slot for each hash value ( logical sector % cacheslots )
+ */
+int *cachehash = NULL;
+
+/** 
+ *  @var      cacheslots
+ *  @brief    Number of slots of the sector cache, 0 = no sector cache
+ */
+int cacheslots = 0;
+
+/** 
+ *  @var      cachehead
+ *  @brief    Most recently used slot
+ */
+int cachehead = -1;
+
+/** 
+ *  @var      cachetail
+ *  @brief    Least recently used slot
+ */
+int cachetail = -1;
+
+/** 
+ *  @var      cache_budget
+ *  @brief    Memory budget of the sector cache in bytes
+ */
+long cache_budget = CACHEBUDGET;
+
+/** 
+ *  @var      cache_hits
+ *  @brief    Number of sectors read from the sector cache
+ */
+unsigned long cache_hits = 0;
+
+/** 
+ *  @var      cache_misses
+ *  @brief    Number of sectors read from the disk
+ */
+unsigned long cache_misses = 0;
+
+/** 
+ *  @var      cache_bytes
+ *  @brief    Number of bytes read from the disk
+ */
+unsigned long cache_bytes = 0;
+
+/** 
+ *  @var      cache_evictions
+ *  @brief    Number of sectors removed from the sector cache
+ */
+unsigned long cache_evictions = 0;
+
 /* Data */
 
 /** 
  *  @var      errormessages
  *  @brief    2-dimensional list of error messages
  */
-char *errormessages[2][16] =
+char *errormessages[2][40] =
  { {"No error",
     "Can't read bootsector",
     "Can't read FAT",
@@ -214,11 +544,35 @@ char *errormessages[2][16] =
     "Can't write root directory",
     "Login Error",
     "You must first log onto a disk",
-    "Only 12- and 16-bit FATs are supported",
+    "Only 12-, 16- and 32-bit FATs are supported",
     "Wrong FAT entry value - not accepted",
     "Wrong DIR entry value - not accepted",
     "Can't copy to FAT",
-    "FAT loop error "
+    "FAT loop error ",
+    "Can't open disk image file",
+    "Can't write sector",
+    "Sector cache is full of sectors, which are not written back",
+    "No free space index - not enough memory",
+    "No directory entry owns this FAT entry",
+    "Wrong line in the edit script - nothing is changed",
+    "Can't open the edit script file",
+    "The contents of the clusters are not yet classified",
+    "No further free text cluster",
+    "No suggestion - the fatentry is not a text cluster, which goes on",
+    "No free entry of the main directory",
+    "No orphaned text clusters",
+    "Wrong search pattern",
+    "The search pattern is not found",
+    "Can't open the pattern file",
+    "Too many or wrong patterns in the pattern file",
+    "The extent of the file is unknown",
+    "Can't read or write the hash index file",
+    "The hash index belongs to a disk with another cluster size",
+    "No free clusters for the new subdirectory",
+    "Can't write the new subdirectory",
+    "Can't read or write a subdirectory",
+    "The direntry is no subdirectory",
+    "All names of the new direntries are used"
      },
    {"No error",
     "Can't allocate enough memory",
@@ -246,7 +600,10 @@ char *bootinfomessages[] =
    "sectors per FAT",
    "sectors per track",
    "number of heads",
-   "number of hidden sectors"
+   "number of hidden sectors",
+   "number of sectors on the disk ( 32-bit )",
+   "sectors per FAT ( FAT32 )",
+   "first cluster of the root directory"
  };
  
  /* Function specifications */
@@ -256,44 +613,86 @@ void errormessage(errtyp4,error4)
  { fprintf(stderr,">>%s<< \n",errormessages[errtyp4][error4]);
  }
 
-int clustosec(cluster,btptr2)
- int cluster;
+sector_tp clustosec(cluster,btptr2)
+ unsigned int cluster;
   bootsec_tp * btptr2;
- { int sector;
+ { sector_tp sector;
    if (offsecs == 0)
     {sector = -1;} /* error condition, no bootinfo available */
    else
-    {sector = ((cluster-2) * (*btptr2).sectors_per_cluster) + offsecs;};
+    {sector = ((sector_tp)(cluster-2) * (*btptr2).sectors_per_cluster) + offsecs;};
    return(sector);
  }
 
 int sectoclus(sector,btptr2)
- int sector;
+ sector_tp sector;
  bootsec_tp * btptr2;
  { int cluster;
    if (offsecs == 0)
     {cluster = 0xFF6;} /* error condition, no bootinfo available */
    else
-    {cluster = ((sector - offsecs)/ (*btptr2).sectors_per_cluster) + 2;};
+    {cluster = (int)((sector - offsecs)/ (*btptr2).sectors_per_cluster) + 2;};
    return(cluster);
  }
 
-void copy_fat(fatnumber,fatptr2,btptr2)
+int copy_fat(fatnumber,fatptr2,btptr2)
  int fatnumber; 
  fatsec_tp * fatptr2;
  bootsec_tp * btptr2;
-  { fatsec_tp *fatptr3;
+  { unsigned char *src,*dst;
     int fatlength; /* of one FAT in number of sectors */
-    int i;
-    fatlength = (*btptr2).sectors_per_fat;
-    if ((fatnumber < (* btptr2).number_of_fats) && (fatnumber > 0))
-     { fatptr3 = ( (char *)fatptr2 + fatlength*fatnumber*secsize);
-       fatptr2 = ( (char *)fatptr2 + fatlength*WORKFAT*secsize);
-       for (i = 0;i < (fatlength * secsize);i++)
-    { *(char *)fatptr3 = *(char *)fatptr2;};
-     }
-    else
-    {errormessage(BOOTERR,WFATNUM);};
+    int i,n;
+    fatlength = FATLENGTH(btptr2);
+    if ((fatnumber >= (* btptr2).number_of_fats) || (fatnumber <= 0))
+     { errormessage(BOOTERR,WFATNUM);
+       return(-1);
+     };
+#ifdef FATSHADOW
+    /* the work FAT must be up to date */
+    flush_fatshadow(fatlength,(fatentry_tp *)fatptr2);
+#endif
+    n = 0;
+    if (fatpaged)
+     { src = malloc(secsize); dst = malloc(secsize);
+       if ((src == NULL) || (dst == NULL))
+        { free(src); free(dst);
+          errormessage(FATALERR,NOMEM);
+          return(-1);
+        };
+       for (i = 0;i < fatlength;i++)
+        { if ((get_fatsector(i,fatlength,WORKFAT,src) != 0) ||
+              (get_fatsector(i,fatlength,fatnumber,dst) != 0))
+           { errormessage(BOOTERR,FREADERR);
+             n = -1;
+             break;
+           };
+          /* just the different sectors are written back */
+          if (memcmp(src,dst,secsize) != 0)
+           { if (cache_write((int)(toupper(drive) - 'A'),1,
+                             (sector_tp)(*btptr2).reserved_sectors +
+                             (sector_tp)fatlength * fatnumber + i,src) != 0)
+              { n = -1;
+                break;
+              };
+             n++;
+           };
+        };
+       free(src); free(dst);
+       return(n);
+     };
+    for (i = 0;i < fatlength;i++)
+     { src = (unsigned char *)fatptr2 + (long)(fatlength * WORKFAT + i) * secsize;
+       dst = (unsigned char *)fatptr2 + (long)(fatlength * fatnumber + i) * secsize;
+       /* just the different sectors are written back */
+       if (memcmp(src,dst,secsize) != 0)
+        { memcpy(dst,src,secsize);
+          if (fatdirty != NULL)
+           { SETBIT(fatdirty,fatlength * fatnumber + i);
+           };
+          n++;
+        };
+     };
+    return(n);
   }
 
 unsigned int get_fatentry12(index,fatlength,fatnumber,fatptr2)
@@ -305,11 +704,11 @@ unsigned int get_fatentry12(index,fatlength,fatnumber,fatptr2)
 #ifdef TEST1
         printf(" fatptr %x : %x \n",FP_SEG(fatptr2),FP_OFF(fatptr2));
 #endif
-    if (index > ((fatlength * secsize) << 1) / 3 )
+    if ((unsigned long)index > (((unsigned long)fatlength * secsize) << 1) / 3 )
      { return(ERRCLUST);
      };
     fatptr2 = (dfatentry12_tp *)
-       ( (char *)fatptr2 + fatlength*fatnumber*secsize);
+       ( (char *)fatptr2 + (long)fatlength * fatnumber * secsize);
 #ifdef TEST1
         printf(" maxindex %d ",((fatlength * secsize) << 1) / 3);
         printf(" fatptr %x : %x \n",FP_SEG(fatptr2),FP_OFF(fatptr2));
@@ -324,9 +723,9 @@ unsigned int get_fatentry12(index,fatlength,fatnumber,fatptr2)
                     ((( (int)(*(fatptr2+(index>>1))).x[1] & 0xF0))>>4);
          }
         else
-         { /* gerade */
-           fentry =  (( (int)(*(fatptr2+(index>>1))).x[1] <<12) >>4)
-                   +  ( (int)(*(fatptr2 +(index>>1))).x[0] & 0xFF);
+         { /* gerade, without relying on a 16-bit "int" */
+           fentry =  (( (unsigned int)(*(fatptr2+(index>>1))).x[1] & 0x0F) << 8)
+                   +  ( (unsigned int)(*(fatptr2 +(index>>1))).x[0] & 0xFF);
          };
         return(fentry);
   }
@@ -342,20 +741,23 @@ unsigned int put_fatentry12(value,index,fatlength,fatnumber,fatptr2)
     printf("value : %x \n",value);
 #endif
     if (value < clusters)
-     { if (index > ((fatlength * secsize) << 1) / 3 )
+     { if ((unsigned long)index > (((unsigned long)fatlength * secsize) << 1) / 3 )
      { return(ERRCLUST);
      };
-       if (value > ((fatlength * secsize) << 1) / 3 )
+       if ((unsigned long)value > (((unsigned long)fatlength * secsize) << 1) / 3 )
      { return(ERRCLUST);
      };
      }
     else
-     { if (value < RESCLUST)
+     { /* reserved values are 0xFF0..0xFFF ( or 0xFFF0..0xFFFF ) */
+       if ((value < RESCLUST) && ((value < RESCLUST12) || (value > 0xFFF)))
      { return(ERRCLUST);
      };
      };
     fatptr2 = (dfatentry12_tp *)
-       ( (char *)fatptr2 + fatlength*fatnumber*secsize);
+       ( (char *)fatptr2 + (long)fatlength * fatnumber * secsize);
+    /* the 12 bits may be spread over 2 sectors */
+    mark_fatbytes((index>>1)*3 + (index % 2),2,fatlength,fatnumber);
     if (index % 2)
      { /* uneven */
        (*(fatptr2+(index>>1))).x[2] = (unsigned char)((value>>4) & 0xFF);
@@ -369,6 +771,9 @@ unsigned int put_fatentry12(value,index,fatlength,fatnumber,fatptr2)
         ((value >> 8) & 0x0F);
        (*(fatptr2+(index>>1))).x[0] = (unsigned char) (value & 0xFF);
      };
+    if (fatnumber == WORKFAT)
+     { note_fatentry(index,value);
+     };
     return(value);
   }
 
@@ -378,11 +783,11 @@ unsigned int get_fatentry16(index,fatlength,fatnumber,fatptr2)
  int fatnumber;
  fatentry16_tp * fatptr2;
   { int fentry;
-    if (index > ((fatlength * secsize)>>1))
+    if ((unsigned long)index > (((unsigned long)fatlength * secsize) >> 1))
      { return(ERRCLUST);
      };
     fatptr2 = (fatentry16_tp *)
-       ( (char *)fatptr2 + fatlength*fatnumber*secsize);
+       ( (char *)fatptr2 + (long)fatlength * fatnumber * secsize);
     fentry = *(fatptr2+index);
     return(fentry);
   }
@@ -393,10 +798,10 @@ unsigned int put_fatentry16(value,index,fatlength,fatnumber,fatptr2)
  int fatnumber;
  fatentry16_tp * fatptr2;
   { if (value < clusters)
-     { if (index > ((fatlength * secsize)>>1))
+     { if ((unsigned long)index > (((unsigned long)fatlength * secsize) >> 1))
      { return(ERRCLUST);
      };
-       if (value > ((fatlength * secsize)>>1))
+       if ((unsigned long)value > (((unsigned long)fatlength * secsize) >> 1))
      { return(ERRCLUST);
      };
      }
@@ -407,11 +812,85 @@ unsigned int put_fatentry16(value,index,fatlength,fatnumber,fatptr2)
 
      };
     fatptr2 = (fatentry16_tp *)
-       ( (char *)fatptr2 + fatlength*fatnumber*secsize);
+       ( (char *)fatptr2 + (long)fatlength * fatnumber * secsize);
+    mark_fatbytes(index << 1,2,fatlength,fatnumber);
     *(fatptr2+index) = value;
+    if (fatnumber == WORKFAT)
+     { note_fatentry(index,value);
+     };
+    return(value);
+  }
+
+unsigned int get_fatentry32(index,fatlength,fatnumber,fatptr2)
+ unsigned int index;
+ int fatlength;
+ int fatnumber;
+ fatentry32_tp * fatptr2;
+  { if ((unsigned long)index >= (((unsigned long)fatlength * secsize) >> 2))
+     { return(ERRCLUST);
+     };
+    fatptr2 = (fatentry32_tp *)
+       ( (char *)fatptr2 + (long)fatlength * fatnumber * secsize);
+    return((unsigned int)(*(fatptr2+index) & FAT32MASK));
+  }
+
+unsigned int put_fatentry32(value,index,fatlength,fatnumber,fatptr2)
+ unsigned int value,index;
+ int fatlength; 
+ int fatnumber;
+ fatentry32_tp * fatptr2;
+  { if ((unsigned long)index >= (((unsigned long)fatlength * secsize) >> 2))
+     { return(ERRCLUST);
+     };
+    if ((value >= (unsigned int)clusters) &&
+        ((value < RESCLUST32) || (value > FAT32MASK)))
+     { return(ERRCLUST);
+     };
+    fatptr2 = (fatentry32_tp *)
+       ( (char *)fatptr2 + (long)fatlength * fatnumber * secsize);
+    mark_fatbytes(index << 2,4,fatlength,fatnumber);
+    /* the upper 4 bits are reserved, keep them */
+    *(fatptr2+index) = (*(fatptr2+index) & ~FAT32MASK) | (value & FAT32MASK);
+    if (fatnumber == WORKFAT)
+     { note_fatentry(index,value);
+     };
     return(value);
   }
 
+void unpack_fat12(src,dst,npairs)
+ dfatentry12_tp * src;
+ unsigned int * dst;
+ unsigned int npairs;
+  { register unsigned char *x;
+    unsigned long w;
+    /* 3 bytes = 2 entries, without branches within the loop */
+    x = (unsigned char *)src;
+    for (;npairs > 0;npairs--)
+     { w = (unsigned long)x[0] + ((unsigned long)x[1] << 8) +
+           ((unsigned long)x[2] << 16);
+       dst[0] = (unsigned int)(w & 0xFFF);
+       dst[1] = (unsigned int)(w >> 12);
+       x += 3; dst += 2;
+     };
+  }
+
+void pack_fat12(src,dst,npairs)
+ unsigned int * src;
+ dfatentry12_tp * dst;
+ unsigned int npairs;
+  { register unsigned char *x;
+    unsigned long w;
+    x = (unsigned char *)dst;
+    for (;npairs > 0;npairs--)
+     { w = (unsigned long)(src[0] & 0xFFF) +
+           ((unsigned long)(src[1] & 0xFFF) << 12);
+       x[0] = (unsigned char)w;
+       x[1] = (unsigned char)(w >> 8);
+       x[2] = (unsigned char)(w >> 16);
+       x += 3; src += 2;
+     };
+  }
+
 #ifdef MISRAC2
 int get_bootinfo(char drive,bootsec_tp *btptr2)
 #else
@@ -422,11 +901,23 @@ int get_bootinfo(drive,btptr2)
  { int error2;
    if ((error2 = absread((int)(toupper(drive) - 'A'),1,0,btptr2)) == NULL)
       { dirsecs = ((*btptr2).number_of_direntries << 5) >> 9;
-    fatsecs = (*btptr2).number_of_fats * (*btptr2).sectors_per_fat;
+    fatsecs = (*btptr2).number_of_fats * FATLENGTH(btptr2);
     offsecs = dirsecs + fatsecs + (*btptr2).reserved_sectors;
-    clusters = sectoclus((*btptr2).number_of_sectors,btptr2);
+    clusters = sectoclus(TOTALSECS(btptr2),btptr2);
     secsize = (*btptr2).bytes_per_sector;
-    if ((*btptr2).number_of_sectors >= 20740)
+    if ((*btptr2).sectors_per_fat == 0)
+     { /* FAT32: the main directory is a cluster chain, at first
+          just its first cluster, see "get_rootchain" */
+       fattyp = FAT32B;
+       dirsecs = (*btptr2).sectors_per_cluster;
+       rootentries = (dirsecs * secsize) / sizeof(struct direntry_tp);
+#ifndef __unix__
+       errormessage(BOOTERR,WRONGFAT);
+       error2 = !0;
+#endif
+     }
+    else
+    if (TOTALSECS(btptr2) >= 20740)
      { fattyp = FAT16B;
      }
     else
@@ -450,6 +941,7 @@ int put_bootinfo(drive,btptr2)
 #endif
  { int error2;
    error2 = abswrite((int)(toupper(drive) - 'A'),1,0,btptr2);
+   cache_drop(0,1);
    return (error2);
  }
 
@@ -465,6 +957,18 @@ int get_maindir(drive,dirptr2)
 #ifdef TEST1
    printf("offsecs %d dirsecs %d \n",offsecs,dirsecs);
 #endif
+   if (fattyp == FAT32B)
+    { /* cluster by cluster */
+      int i,spc;
+      spc = (*btptr).sectors_per_cluster;
+      error2 = (rootclusters == NULL);
+      for (i = 0;(i < dirsecs / spc) && !error2;i++)
+       { error2 = (absread((int)(toupper(drive) - 'A'),spc,
+             clustosec(rootclusters[i],btptr),
+             (char *)dirptr2 + (long)i * spc * secsize) != NULL);
+       };
+      return (error2);
+    };
    error2 =
       (absread((int)(toupper(drive) - 'A'),dirsecs,offsecs-dirsecs,dirptr2)
       != NULL);
@@ -483,12 +987,78 @@ int put_maindir(drive,dirptr2)
 #ifdef TEST1
    printf("offsecs %d dirsecs %d \n",offsecs,dirsecs);
 #endif
-   error2 =
-      (abswrite((int)(toupper(drive) - 'A'),dirsecs,offsecs-dirsecs,dirptr2)
-      != NULL);
+   error2 = put_dirsecs(drive,dirptr2,0);
    return (error2);
  }
 
+int put_dirsecs(drive,dirptr2,readback)
+ char drive;
+ struct direntry_tp *dirptr2;
+ int readback;
+ { int i,k,spc,error2;
+   char *bufptr;
+   if (fattyp != FAT32B)
+    { return(put_dirtysecs(drive,dirdirty,dirsecs,offsecs-dirsecs,
+                           dirptr2,readback));
+    };
+   /* FAT32: the modified sectors of the main directory,
+      consecutive sectors within a cluster by a single "abswrite" */
+   spc = (*btptr).sectors_per_cluster;
+   error2 = 0;
+   for (i = 0;(i < dirsecs) && (error2 == 0);i++)
+    { if (TESTBIT(dirdirty,i))
+       { for (k = i + 1;(k < dirsecs) && (k % spc != 0) && TESTBIT(dirdirty,k);k++) {};
+         bufptr = (char *)dirptr2 + (long)i * secsize;
+         if (readback)
+          { error2 = (absread((int)(toupper(drive) - 'A'),k - i,
+                 clustosec(rootclusters[i / spc],btptr) + i % spc,bufptr) != 0);
+          }
+         else
+          { error2 = (abswrite((int)(toupper(drive) - 'A'),k - i,
+                 clustosec(rootclusters[i / spc],btptr) + i % spc,bufptr) != 0);
+            cache_drop(clustosec(rootclusters[i / spc],btptr) + i % spc,k - i);
+          };
+         for (;i < k;i++)
+          { CLRBIT(dirdirty,i);
+          };
+         i--;
+       };
+    };
+   return(error2);
+ }
+
+int get_rootchain(btptr2)
+ bootsec_tp *btptr2;
+ { unsigned int cl,loopstart;
+   long i,n;
+   int spc;
+   spc = (*btptr2).sectors_per_cluster;
+   n = chain_length((unsigned int)(*btptr2).root_cluster,FATLENGTH(btptr2),
+                    WORKFAT,(fatentry_tp *)fatptr,&loopstart);
+   if (n == 0)
+    { /* at least the first cluster */
+      n = 1;
+    };
+   free(rootclusters);
+   rootclusters = calloc((size_t)n,sizeof(unsigned int));
+   if (rootclusters == NULL)
+    { return(!0);
+    };
+   cl = (unsigned int)(*btptr2).root_cluster;
+   for (i = 0;i < n;i++)
+    { rootclusters[i] = cl;
+      cl = get_fat_value(cl,FATLENGTH(btptr2),WORKFAT,(fatentry_tp *)fatptr);
+    };
+   dirsecs = (int)n * spc;
+   rootentries = (dirsecs * secsize) / sizeof(struct direntry_tp);
+   free(dirdirty);
+   dirdirty = calloc(BITMAPSIZE(dirsecs) + 1,1);
+   if ((realloc_maindir(rootentries,&dirptr) != NULL) || (dirdirty == NULL))
+    { return(!0);
+    };
+   return(0);
+ }
+
 #ifdef MISRAC
 int get_fats(char drive,fatsec_tp *fatptr2,bootsec_tp *btptr2)
 #else
@@ -498,6 +1068,10 @@ int get_fats(drive,fatptr2,btptr2)
  bootsec_tp *btptr2;
 #endif
  { int error2;
+   if (fatpaged)
+    { /* read on demand, see "fat_page" */
+      return(0);
+    };
    /* first logical sector = sector 0 !! */
    error2 = (absread((int)(toupper(drive) - 'A'),
            fatsecs,(*btptr2).reserved_sectors,fatptr2) != NULL);
@@ -513,12 +1087,99 @@ int put_fats(drive,fatptr2,btptr2)
  bootsec_tp *btptr2;
 #endif
  { int error2;
+   if (fatpaged)
+    { /* modified in the sector cache, see "cache_flush" */
+      return(0);
+    };
    /* first logical sector = sector 0 !! */
-   error2 = (abswrite((int)(toupper(drive) - 'A'),
-                                 fatsecs,(*btptr2).reserved_sectors,fatptr2) != NULL);
+   error2 = put_dirtysecs(drive,fatdirty,fatsecs,(*btptr2).reserved_sectors,
+                          fatptr2,0);
    return (error2);
  }
 
+int alloc_dirty()
+ { free(fatdirty); free(dirdirty);
+   fatdirty = calloc(BITMAPSIZE(fatsecs) + 1,1);
+   dirdirty = calloc(BITMAPSIZE(dirsecs) + 1,1);
+   bootdirty = 0;
+   return((fatdirty == NULL) || (dirdirty == NULL));
+ }
+
+void mark_fatbytes(offset,nbytes,fatlength,fatnumber)
+ unsigned int offset,nbytes;
+ int fatlength,fatnumber;
+ { int sector;
+   if (fatdirty == NULL)
+    { return;
+    };
+   for (sector = offset / secsize;sector <= (offset + nbytes - 1) / secsize;
+        sector++)
+    { if (sector < fatlength)
+       { SETBIT(fatdirty,fatlength * fatnumber + sector);
+       };
+    };
+ }
+
+void mark_direntry(dirptr2)
+ struct direntry_tp *dirptr2;
+ { int sector;
+   if (dirdirty == NULL)
+    { return;
+    };
+   sector = (int)(((long)(dirptr2 - dirptr) * sizeof(struct direntry_tp)) / secsize);
+   if ((sector >= 0) && (sector < dirsecs))
+    { SETBIT(dirdirty,sector);
+    }
+   else
+    { mark_dirnode(dirptr2);
+    };
+   owner_direntry(dirptr2);
+ }
+
+#ifdef MISRAC
+int put_dirtysecs(char drive,unsigned char *dirtymap,int nsects,sector_tp lsect,
+                  void *buffer,int readback)
+#else
+int put_dirtysecs(drive,dirtymap,nsects,lsect,buffer,readback)
+ char drive;
+ unsigned char *dirtymap;
+ int nsects;
+ sector_tp lsect;
+ void *buffer;
+ int readback;
+#endif
+ { int i,k,error2;
+   char *bufptr;
+   error2 = 0;
+   if (dirtymap == NULL)
+    { return(!0);
+    };
+   for (i = 0;i < nsects;)
+    { if (!TESTBIT(dirtymap,i))
+       { i++;
+       }
+      else
+       { /* run of consecutive modified sectors */
+         for (k = i + 1;(k < nsects) && TESTBIT(dirtymap,k);k++)
+          { };
+         bufptr = (char *)buffer + (long)i * secsize;
+         if (readback)
+          { error2 |= (absread((int)(toupper(drive) - 'A'),
+                       k - i,lsect + i,bufptr) != 0);
+          }
+         else
+          { error2 |= (abswrite((int)(toupper(drive) - 'A'),
+                       k - i,lsect + i,bufptr) != 0);
+            cache_drop(lsect + i,k - i);
+          };
+         for (;i < k;i++)
+          { CLRBIT(dirtymap,i);
+          };
+       };
+    };
+   return(error2);
+ }
+
 void link_startcluster(selfentry,dirptr2)
  int selfentry;
  struct direntry_tp * dirptr2;
@@ -526,8 +1187,12 @@ void link_startcluster(selfentry,dirptr2)
    printf ("Do You really want to modify the directory ? Y/N ");
    c = getch();
    printf("\n");
-   if (toupper(c))
-    { (* dirptr2).startcluster = selfentry; };
+   if (toupper(c) == 'Y')
+    { (* dirptr2).startcluster = selfentry & 0xFFFF;
+      if (fattyp == FAT32B)
+       { (* dirptr2).startcluster_high = (word_tp)((unsigned long)selfentry >> 16);
+       };
+      mark_direntry(dirptr2); };
  }
 
 int alloc_sector(btptr2)
@@ -567,16 +1232,444 @@ int realloc_maindir(dirlength,dirptr2)
 int alloc_fats(fatlength,fatptr2)
  int fatlength;
  fatsec_tp **fatptr2;
- { *fatptr2 = calloc(fatlength,secsize);
-   return(*fatptr2 == NULL);
+ { *fatptr2 = NULL;
+   if ((long)fatlength * secsize <= FATBUDGET)
+    { *fatptr2 = calloc(fatlength,secsize);
+    };
+   fatpaged = (*fatptr2 == NULL);
+   if (fatpaged)
+    { /* not enough memory for the FATs, then they are paged */
+      free(fatwindow);
+      fatwindow = calloc(FATWINDOW,secsize);
+      return(fatwindow == NULL);
+    };
+   return(0);
  }
 
 int realloc_fats(fatlength,fatptr2)
  int fatlength;
  fatsec_tp **fatptr2;
- { *fatptr2 = realloc(*fatptr2,fatlength * secsize);
+ { free(*fatptr2);
+   return(alloc_fats(fatlength,fatptr2));
+ }
+
+#ifdef IMGDISK
+int map_maindir(dirptr2)
+ struct direntry_tp **dirptr2;
+ { if (fattyp == FAT32B)
+    { /* not contiguous, see "get_rootchain" */
+      *dirptr2 = NULL;
+      return(!0);
+    };
+   *dirptr2 = absmap((int)(toupper(drive) - 'A'),dirsecs,offsecs-dirsecs);
+   return(*dirptr2 == NULL);
+ }
+
+int map_fats(fatptr2)
+ fatsec_tp **fatptr2;
+ { *fatptr2 = absmap((int)(toupper(drive) - 'A'),
+                     fatsecs,(*btptr).reserved_sectors);
    return(*fatptr2 == NULL);
  }
+#endif
+
+/****************/
+/* sector cache */
+/****************/
+
+int alloc_cache()
+ { int i;
+   /* modified sectors, which are not written back, are discarded */
+   free(cache); free(cachedata); free(cachehash);
+   cache = NULL; cachedata = NULL; cachehash = NULL;
+   cachehead = -1; cachetail = -1;
+   cacheslots = (int)(cache_budget / secsize);
+   if (fatpaged && (cacheslots < 2 * FATWINDOW))
+    { /* the page pool of a paged FAT */
+      cacheslots = 2 * FATWINDOW;
+    };
+   if (cacheslots < 1)
+    { cacheslots = 0;
+      return(0);
+    };
+   cache = calloc(cacheslots,sizeof(struct cacheslot_tp));
+   cachedata = calloc(cacheslots,secsize);
+   cachehash = calloc(cacheslots,sizeof(int));
+   if ((cache == NULL) || (cachedata == NULL) || (cachehash == NULL))
+    { free(cache); free(cachedata); free(cachehash);
+      cache = NULL; cachedata = NULL; cachehash = NULL;
+      cacheslots = 0;
+      return(!0);
+    };
+   for (i = 0;i < cacheslots;i++)
+    { cache[i].lsect = -1;
+      cache[i].dirty = 0;
+      cache[i].prev = i - 1;
+      cache[i].next = (i < (cacheslots - 1)) ? (i + 1) : -1;
+      cache[i].hnext = -1;
+      cachehash[i] = -1;
+    };
+   cachehead = 0; cachetail = cacheslots - 1;
+   return(0);
+ }
+
+int cache_find(lsect)
+ sector_tp lsect;
+ { int slot;
+   if (cacheslots == 0)
+    { return(-1);
+    };
+   for (slot = cachehash[(int)(lsect % cacheslots)];slot >= 0;slot = cache[slot].hnext)
+    { if (cache[slot].lsect == lsect)
+       { return(slot);
+       };
+    };
+   return(-1);
+ }
+
+void cache_touch(slot)
+ int slot;
+ { if (slot == cachehead)
+    { return;
+    };
+   /* unlink */
+   cache[cache[slot].prev].next = cache[slot].next;
+   if (cache[slot].next >= 0)
+    { cache[cache[slot].next].prev = cache[slot].prev; }
+   else
+    { cachetail = cache[slot].prev; };
+   /* link as most recently used */
+   cache[slot].prev = -1;
+   cache[slot].next = cachehead;
+   cache[cachehead].prev = slot;
+   cachehead = slot;
+ }
+
+unsigned char *cache_insert(lsect)
+ sector_tp lsect;
+ { int slot,*hptr;
+   /* least recently used slot, which is not modified */
+   for (slot = cachetail;(slot >= 0) && cache[slot].dirty;slot = cache[slot].prev)
+    { };
+   if (slot < 0)
+    { return(NULL);
+    };
+   if (cache[slot].lsect >= 0)
+    { /* remove from the hash chain */
+      for (hptr = &cachehash[(int)(cache[slot].lsect % cacheslots)];*hptr != slot;
+           hptr = &cache[*hptr].hnext)
+       { };
+      *hptr = cache[slot].hnext;
+      cache_evictions++;
+    };
+   cache[slot].lsect = lsect;
+   cache[slot].hnext = cachehash[(int)(lsect % cacheslots)];
+   cachehash[(int)(lsect % cacheslots)] = slot;
+   cache_touch(slot);
+   return(cachedata + (long)slot * secsize);
+ }
+
+int cache_read(drive,nsects,lsect,buffer)
+ int drive,nsects;
+ sector_tp lsect;
+ unsigned char *buffer;
+ { int i,k,slot;
+   unsigned char *data;
+   for (i = 0;i < nsects;)
+    { if ((slot = cache_find(lsect + i)) >= 0)
+       { memcpy(buffer + i * secsize,cachedata + (long)slot * secsize,secsize);
+         cache_touch(slot);
+         cache_hits++;
+         i++;
+       }
+      else
+       { /* consecutive missing sectors are read by one "absread" */
+         for (k = i + 1;(k < nsects) && (cache_find(lsect + k) < 0);k++)
+          { };
+         if (absread(drive,k - i,lsect + i,buffer + i * secsize) != 0)
+          { return(-1);
+          };
+         cache_misses += k - i;
+         cache_bytes += (unsigned long)(k - i) * secsize;
+         for (;i < k;i++)
+          { if ((data = cache_insert(lsect + i)) != NULL)
+             { memcpy(data,buffer + i * secsize,secsize);
+             };
+          };
+       };
+    };
+   return(0);
+ }
+
+int cache_write(drive,nsects,lsect,buffer)
+ int drive,nsects;
+ sector_tp lsect;
+ unsigned char *buffer;
+ { int i,slot;
+   unsigned char *data;
+   if (cacheslots == 0)
+    { return(abswrite(drive,nsects,lsect,buffer));
+    };
+   for (i = 0;i < nsects;i++)
+    { if ((slot = cache_find(lsect + i)) >= 0)
+       { data = cachedata + (long)slot * secsize;
+         cache_touch(slot);
+       }
+      else
+       { if ((data = cache_insert(lsect + i)) == NULL)
+          { errormessage(BOOTERR,CACHEERR);
+            return(-1);
+          };
+         slot = cachehead;
+       };
+      memcpy(data,buffer + i * secsize,secsize);
+      cache[slot].dirty = !0;
+    };
+   return(0);
+ }
+
+void cache_drop(lsect,nsects)
+ sector_tp lsect;
+ int nsects;
+ { int i,slot,*hptr;
+   for (i = 0;i < nsects;i++)
+    { if ((slot = cache_find(lsect + i)) < 0)
+       { continue;
+       };
+      /* remove from the hash chain */
+      for (hptr = &cachehash[(int)(cache[slot].lsect % cacheslots)];*hptr != slot;
+           hptr = &cache[*hptr].hnext)
+       { };
+      *hptr = cache[slot].hnext;
+      cache[slot].lsect = -1;
+      cache[slot].hnext = -1;
+      cache[slot].dirty = 0;
+      /* link as least recently used, the slot is taken next */
+      if (slot != cachetail)
+       { if (cache[slot].prev >= 0)
+          { cache[cache[slot].prev].next = cache[slot].next; }
+         else
+          { cachehead = cache[slot].next; };
+         cache[cache[slot].next].prev = cache[slot].prev;
+         cache[slot].next = -1;
+         cache[slot].prev = cachetail;
+         cache[cachetail].next = slot;
+         cachetail = slot;
+       };
+    };
+ }
+
+int cache_flush(drive)
+ int drive;
+ { int slot,first,n,k,error2;
+   unsigned char *wbuffer;
+   error2 = 0;
+   do
+    { /* lowest modified sector, and the consecutive ones after it */
+      first = -1;
+      for (slot = 0;slot < cacheslots;slot++)
+       { if (cache[slot].dirty &&
+             ((first < 0) || (cache[slot].lsect < cache[first].lsect)))
+          { first = slot;
+          };
+       };
+      if (first >= 0)
+       { for (n = 1;((slot = cache_find(cache[first].lsect + n)) >= 0) &&
+                    cache[slot].dirty;n++)
+          { };
+         if ((wbuffer = malloc(n * secsize)) == NULL)
+          { errormessage(FATALERR,NOMEM);
+            return(-1);
+          };
+         for (k = 0;k < n;k++)
+          { slot = cache_find(cache[first].lsect + k);
+            memcpy(wbuffer + k * secsize,cachedata + (long)slot * secsize,secsize);
+            cache[slot].dirty = 0;
+          };
+         if (abswrite(drive,n,cache[first].lsect,wbuffer) != 0)
+          { error2 = -1;
+          };
+         free(wbuffer);
+       };
+    } while (first >= 0);
+   return(error2);
+ }
+
+void show_cache()
+ { int slot,used,dirty;
+   long kbytes;
+   int c;
+   used = 0; dirty = 0;
+   for (slot = 0;slot < cacheslots;slot++)
+    { if (cache[slot].lsect >= 0) { used++; };
+      if (cache[slot].dirty) { dirty++; };
+    };
+   printf("cache size        : %ld bytes, %d sectors\n",cache_budget,cacheslots);
+   printf("cached sectors    : %d, not written back : %d\n",used,dirty);
+   printf("hits / misses     : %lu / %lu",cache_hits,cache_misses);
+   if ((cache_hits + cache_misses) > 0)
+    { printf(" ( hit ratio %lu %% )",
+             (cache_hits * 100) / (cache_hits + cache_misses));
+    };
+   printf("\n");
+   printf("bytes read        : %lu\n",cache_bytes);
+   printf("evictions         : %lu\n",cache_evictions);
+   printf("Do You want to change the cache size ? Y/N ");
+   c = getch();
+   printf("\n");
+   if (toupper(c) == 'Y')
+    { if (dirty > 0)
+       { errormessage(BOOTERR,CACHEERR);
+         return;
+       };
+      kbytes = cache_budget / 1024;
+      printf("? new cache size in KBytes : ");
+      scanf("%ld",&kbytes);
+      if (kbytes >= 0)
+       { cache_budget = kbytes * 1024;
+         if (alloc_cache() != 0)
+          { errormessage(FATALERR,NOMEM);
+          };
+       };
+    };
+ }
+
+/*************/
+/* paged FAT */
+/*************/
+
+int fat_page(offset,fatlength,fatnumber)
+ unsigned long offset;
+ int fatlength,fatnumber;
+ { sector_tp lsect;
+   int slot,n;
+   if ((fatwindow == NULL) || (offset >= (unsigned long)fatlength * secsize))
+    { return(-1);
+    };
+   lsect = (sector_tp)(*btptr).reserved_sectors +
+           (sector_tp)fatlength * fatnumber + (sector_tp)(offset / secsize);
+   if ((slot = cache_find(lsect)) >= 0)
+    { cache_touch(slot);
+      cache_hits++;
+      return(slot);
+    };
+   /* read ahead, the next entries of a chain
+      are mostly within the next sectors */
+   n = fatlength - (int)(offset / secsize);
+   if (n > FATWINDOW)
+    { n = FATWINDOW;
+    };
+   if (cache_read((int)(toupper(drive) - 'A'),n,lsect,fatwindow) != 0)
+    { return(-1);
+    };
+   return(cache_find(lsect));
+ }
+
+int get_fatbyte(offset,fatlength,fatnumber)
+ unsigned long offset;
+ int fatlength,fatnumber;
+ { int slot;
+   if ((slot = fat_page(offset,fatlength,fatnumber)) < 0)
+    { return(-1);
+    };
+   return(*(cachedata + (long)slot * secsize + (unsigned int)(offset % secsize)));
+ }
+
+int put_fatbyte(value,offset,fatlength,fatnumber)
+ unsigned int value;
+ unsigned long offset;
+ int fatlength,fatnumber;
+ { int slot;
+   if ((slot = fat_page(offset,fatlength,fatnumber)) < 0)
+    { return(-1);
+    };
+   *(cachedata + (long)slot * secsize + (unsigned int)(offset % secsize)) =
+      (unsigned char)(value & 0xFF);
+   cache[slot].dirty = !0;
+   return(0);
+ }
+
+int get_fatsector(sector,fatlength,fatnumber,buffer)
+ int sector,fatlength,fatnumber;
+ unsigned char *buffer;
+ { int slot;
+   if ((slot = fat_page((unsigned long)sector * secsize,fatlength,fatnumber)) < 0)
+    { return(-1);
+    };
+   memcpy(buffer,cachedata + (long)slot * secsize,secsize);
+   return(0);
+ }
+
+unsigned int get_fatentry_paged(index,fatlength,fatnumber)
+ unsigned int index;
+ int fatlength,fatnumber;
+ { unsigned long offset,fentry;
+   int i,nbytes,b;
+   offset = (fattyp == FAT12B) ? (((unsigned long)index * 3) >> 1) :
+            ((unsigned long)index * (fattyp >> 3));
+   nbytes = (fattyp == FAT32B) ? 4 : 2;
+   fentry = 0;
+   for (i = 0;i < nbytes;i++)
+    { /* the 12 bits may be spread over 2 sectors */
+      if ((b = get_fatbyte(offset + i,fatlength,fatnumber)) < 0)
+       { return(ERRCLUST);
+       };
+      fentry |= (unsigned long)b << (i << 3);
+    };
+   switch (fattyp)
+    { case FAT12B:
+       { fentry = (index % 2) ? (fentry >> 4) : (fentry & 0xFFF);
+         break;}
+      case FAT32B:
+       { fentry &= FAT32MASK;
+         break;}
+      default:
+       { break;};
+    };
+   return((unsigned int)fentry);
+ }
+
+unsigned int put_fatentry_paged(value,index,fatlength,fatnumber)
+ unsigned int value,index;
+ int fatlength,fatnumber;
+ { unsigned long offset,fentry;
+   int i,nbytes,b;
+   offset = (fattyp == FAT12B) ? (((unsigned long)index * 3) >> 1) :
+            ((unsigned long)index * (fattyp >> 3));
+   nbytes = (fattyp == FAT32B) ? 4 : 2;
+   fentry = 0;
+   for (i = 0;i < nbytes;i++)
+    { if ((b = get_fatbyte(offset + i,fatlength,fatnumber)) < 0)
+       { return(ERRCLUST);
+       };
+      fentry |= (unsigned long)b << (i << 3);
+    };
+   switch (fattyp)
+    { case FAT12B:
+       { fentry = (index % 2) ? ((fentry & 0x000F) | ((unsigned long)value << 4)) :
+                                ((fentry & 0xF000) | (value & 0xFFF));
+         break;}
+      case FAT32B:
+       { /* the upper 4 bits are reserved, keep them */
+         fentry = (fentry & ~FAT32MASK) | (value & FAT32MASK);
+         break;}
+      default:
+       { fentry = value;
+         break;};
+    };
+   for (i = 0;i < nbytes;i++)
+    { if (put_fatbyte((unsigned int)(fentry >> (i << 3)),offset + i,
+                      fatlength,fatnumber) != 0)
+       { /* all slots are modified */
+         errormessage(BOOTERR,CACHEERR);
+         return(ERRCLUST);
+       };
+    };
+   if (fatnumber == WORKFAT)
+    { note_fatentry(index,value);
+    };
+   return(value);
+ }
 
 void display_bootinfo(btptr2)
  bootsec_tp * btptr2;
@@ -595,13 +1688,21 @@ void display_bootinfo(btptr2)
  printf("%s : %d \n",bootinfomessages[11],(*btptr2).number_of_heads);
  printf
   ("%s : %d \n",bootinfomessages[11],(*btptr2).number_of_hiddensectors);
+ if (fattyp == FAT32B)
+  { printf("%s : $%lx \n",bootinfomessages[13],
+           (unsigned long)(*btptr2).number_of_sectors32);
+    printf("%s : %ld \n",bootinfomessages[14],
+           (long)(*btptr2).sectors_per_fat32);
+    printf("%s : $%lx \n",bootinfomessages[15],
+           (unsigned long)(*btptr2).root_cluster);
+  };
  }
 
 void display_direntry(alldisp,dirptr2)
  struct direntry_tp * dirptr2;
  int alldisp;
  { int k;
-   char flags[11];
+   char flags[12];
 
       if (( (* dirptr2).filename[0] != 0x00) || alldisp )
         { strcpy(flags,"           ");
@@ -657,7 +1758,7 @@ void display_direntry(alldisp,dirptr2)
            { printf ("%c",(* dirptr2).extension[k]);
            };
           printf("   $(%8lx)  %2d.%2d.%2d  %2d.%2d.%2d",
-          (* dirptr2).filelength,
+          (unsigned long)(* dirptr2).filelength,
           (* dirptr2).day,
           (* dirptr2).month,
           (* dirptr2).year + 80,
@@ -682,18 +1783,13 @@ void display_dir(dirlength,dirptr2)
 void display_fats(clusternumber,fatlength,fatnumber,fatptr2)
  int fatlength,fatnumber,clusternumber;
  fatentry_tp * fatptr2;
- { int i,cl,k;;
-   k = 0;
+ { int i,cl,k;
+   unsigned int n,block[FATBLOCK];
+   k = 0; n = 0;
    for (i=0;i<clusternumber;i++)
-     { switch (fattyp)
-        { case FAT12B:
-        {cl = get_fatentry12(i,fatlength,fatnumber,fatptr2);break;}
-          case FAT16B:
-        {cl = get_fatentry16(i,fatlength,fatnumber,
-                     (fatentry16_tp *)fatptr2);break;}
-          default:
-        {errormessage(BOOTERR,WRONGFAT);exit(1);break;};
-        };
+     { if ((i % FATBLOCK) == 0)
+          { n = decode_fats(i,FATBLOCK,fatlength,fatnumber,fatptr2,block); };
+       cl = ((unsigned int)(i % FATBLOCK) < n) ? block[i % FATBLOCK] : ERRCLUST;
 #ifdef FTEST
        if ((k % 8) == 0)
           { printf("\n->$(%5x):",k); };
@@ -718,24 +1814,8 @@ void display_direntries_fatentries(alldisp,fatlength,fatnumber,dirlength,
     { int fatvalue;
       printf("->$(%4x) ",i);
       display_direntry(!0,dirptr2);
-      fatvalue = (* dirptr2).startcluster;
-          while ( (fatvalue != EOFAT) && (fatvalue != NOFAT) )
-       { printf("%5x",fatvalue);
-        switch (fattyp)
-         { case FAT12B:
-        {fatvalue =
-             get_fatentry12(fatvalue,fatlength,fatnumber,fatptr2);
-         break;}
-           case FAT16B:
-        {fatvalue =
-             get_fatentry16(fatvalue,fatlength,
-                    fatnumber,(fatentry16_tp *)fatptr2);
-         break;}
-           default:
-        {errormessage(BOOTERR,WRONGFAT);exit(1);break;};
-         };
-       };
-     printf("%5x\n",fatvalue);
+      fatvalue = STARTCLUSTER(dirptr2);
+      display_chain(fatvalue,fatlength,fatnumber,fatptr2);
     };
     };
    printf("\n");
@@ -750,24 +1830,8 @@ void display_direntry_fatentries(alldisp,seldentry,fatlength,
    if (( (* dirptr2).filename[0] != 0x00) || alldisp)
      { int fatvalue;
        display_direntry(!0,dirptr2);
-       fatvalue = (* dirptr2).startcluster;
-       while ( (fatvalue != EOFAT) && (fatvalue != NOFAT) )
-      { printf("%5x",fatvalue);
-        switch (fattyp)
-         { case FAT12B:
-        {fatvalue =
-             get_fatentry12(fatvalue,fatlength,fatnumber,fatptr2);
-         break;}
-           case FAT16B:
-        {fatvalue =
-             get_fatentry16(fatvalue,fatlength,
-                    fatnumber,(fatentry16_tp *)fatptr2);
-         break;}
-           default:
-        {errormessage(BOOTERR,WRONGFAT);exit(1);break;};
-         };
-      };
-       printf("%5x\n",fatvalue);
+       fatvalue = STARTCLUSTER(dirptr2);
+       display_chain(fatvalue,fatlength,fatnumber,fatptr2);
      }
    else
      { printf("no entry\n");
@@ -782,6 +1846,10 @@ int newlog(fatptr2,btptr2,dirptr2)
  struct direntry_tp *dirptr2;
  { int error1,error2,error3,noerr;
    noerr = 0;
+   /* the contents of the clusters of the old disk */
+   free(classmap); classmap = NULL;
+   free_suggestindex();
+   free_dirtree();
    /* bootinfo */
    error1 = get_bootinfo(drive,btptr2);
    if (error1 != NULL)
@@ -791,10 +1859,28 @@ int newlog(fatptr2,btptr2,dirptr2)
    if  (error2 != NULL)
     { errormessage(BOOTERR,FREADERR);
       noerr = !0;}
+   else
+    {
+#ifdef FATSHADOW
+      build_fatshadow(FATLENGTH(btptr2),(fatentry_tp *)fatptr2);
+#endif
+      build_freeindex(FATLENGTH(btptr2),(fatentry_tp *)fatptr2);
+      if (fattyp == FAT32B)
+       { if (get_rootchain(btptr2) != NULL)
+          { errormessage(FATALERR,NOMEM);
+            noerr = !0;
+          };
+         /* the main directory may be reallocated */
+         dirptr2 = dirptr;
+       };
+    };
    error3 = get_maindir(drive,dirptr2);
    if  (error3 != NULL)
     { errormessage(BOOTERR,DREADERR);
       noerr = !0;}
+   if (!noerr)
+    { build_ownerindex();
+    };
    return(noerr);
  }
 
@@ -802,17 +1888,24 @@ int writeback(fatptr2,btptr2,dirptr2)
  fatsec_tp *fatptr2;
  bootsec_tp *btptr2;
  struct direntry_tp *dirptr2;
- { int c,error1,error2,error3,noerr;
+ { int c,error1,error2,error3,noerr,nd;
    noerr = 0;
    printf("Do You really want to write back ? Y/N ");
    c = getch();  /* ansi specific */
    printf("\n");
    if (toupper(c) == 'Y')
     { /* bootinfo */
-      error1 = put_bootinfo(drive,btptr2);
+      if (bootdirty)
+    { error1 = put_bootinfo(drive,btptr2);
       if (error1 != NULL)
-    { errormessage(BOOTERR,BWRITEERR);
-      noerr = !0;};
+        { errormessage(BOOTERR,BWRITEERR);
+          noerr = !0;}
+      else
+        { bootdirty = 0;};
+    };
+#ifdef FATSHADOW
+      flush_fatshadow(FATLENGTH(btptr2),(fatentry_tp *)fatptr2);
+#endif
       error2 = put_fats(drive,fatptr2,btptr2);
       if  (error2 != NULL)
     { errormessage(BOOTERR,FWRITEERR);
@@ -821,12 +1914,31 @@ int writeback(fatptr2,btptr2,dirptr2)
       if  (error3 != NULL)
     { errormessage(BOOTERR,DWRITEERR);
       noerr = !0;}
-    };
-   /* "flush buffer" funktion, read again */
-   error3 = get_maindir(drive,dirptr2);
-   if  (error3 != NULL)
+      if (put_dirtree(FATLENGTH(btptr2),(fatentry_tp *)fatptr2,btptr2) != 0)
+    { errormessage(BOOTERR,DIRTREEERR);
+      noerr = !0;}
+      if (cache_flush((int)(toupper(drive) - 'A')) != 0)
+    { errormessage(BOOTERR,SWRITEERR);
+      noerr = !0;}
+    }
+   else
+    { /* "flush buffer" funktion, read again the modified 
+         directory sectors, the written back ones are up to date */
+      error3 = put_dirsecs(drive,dirptr2,!0);
+      if  (error3 != NULL)
     { errormessage(BOOTERR,DREADERR);
       noerr = !0;}
+      for (nd = 1;nd < ndirnodes;nd++)
+    { if (dirtree[nd].dirty &&
+          (read_dirnode(nd,FATLENGTH(btptr2),(fatentry_tp *)fatptr2,btptr2) < 0))
+        { errormessage(BOOTERR,DIRTREEERR);
+          noerr = !0;};
+    };
+      build_ownerindex();
+      if (!noerr)
+    { /* nothing is written back */
+      noerr = -1;};
+    };
  return(noerr);
  }
 
@@ -853,12 +1965,26 @@ int alloc_all()
          log_ok = 0; bootlog_ok = 0; return(error2);}
    else
        { bootlog_ok = !0; };
-   if ( alloc_maindir((*btptr).number_of_direntries,&dirptr) != NULL)
+#ifdef IMGDISK
+   /* the FATs and the directory are not copied, but mapped */
+   map_dir = !map_maindir(&dirptr);
+   map_fat = !map_fats(&fatptr);
+   fatpaged = 0;
+   if (!map_dir)
+#endif
+   if ( alloc_maindir(DIRENTRIES(btptr),&dirptr) != NULL)
        { errormessage(FATALERR,NOMEM); /*exit(1);*/ };
+#ifdef IMGDISK
+   if (!map_fat)
+#endif
    if ( alloc_fats(fatsecs,&fatptr) != NULL)
        { errormessage(FATALERR,NOMEM); /*exit(1);*/ };
    if ( alloc_cluster(&viptr,btptr) != NULL)
        { errormessage(FATALERR,NOMEM); exit(1);}
+   if ( alloc_cache() != NULL)
+       { errormessage(FATALERR,NOMEM); };
+   if ( alloc_dirty() != NULL)
+       { errormessage(FATALERR,NOMEM); };
    return(error2);
   }
 
@@ -870,12 +1996,30 @@ int realloc_all()
      log_ok = 0; bootlog_ok = 0; return(error2);}
    else
        { bootlog_ok = !0;};
-   if ( realloc_maindir((*btptr).number_of_direntries,&dirptr) != NULL)
+#ifdef IMGDISK
+   /* a mapping must not be reallocated, and a buffer
+      is not necessary any more, if there is a mapping now */
+   if (!map_dir) { free(dirptr); };
+   if (!map_fat) { free(fatptr); };
+   dirptr = NULL; fatptr = NULL;
+   map_dir = !map_maindir(&dirptr);
+   map_fat = !map_fats(&fatptr);
+   fatpaged = 0;
+   if (!map_dir)
+#endif
+   if ( realloc_maindir(DIRENTRIES(btptr),&dirptr) != NULL)
        { errormessage(FATALERR,NOMEM); /*exit(1);*/ };
+#ifdef IMGDISK
+   if (!map_fat)
+#endif
    if ( realloc_fats(fatsecs,&fatptr) != NULL)
        { errormessage(FATALERR,NOMEM); /*exit(1);*/ };
    if ( realloc_cluster(&viptr,btptr) != NULL)
        { errormessage(FATALERR,NOMEM); /*exit(1);*/ };
+   if ( alloc_cache() != NULL)
+       { errormessage(FATALERR,NOMEM); };
+   if ( alloc_dirty() != NULL)
+       { errormessage(FATALERR,NOMEM); };
    return(error2);
  }
 
@@ -926,22 +2070,26 @@ int show_fat_options(selfentry,seldentry,fatlength,fatnumber,fatptr2,dirptr2)
    printf("\n");
    printf("************************************FAT*MENUE*****************************\n");
    /* dirptr2 already points to the right entry */
-   switch (fattyp)
-        { case FAT12B:
-        {cl = get_fatentry12(selfentry,fatlength,fatnumber,
-                     fatptr2);break;}
-          case FAT16B:
-        {cl = get_fatentry16(selfentry,fatlength,fatnumber,
-                     (fatentry16_tp *)fatptr2);break;}
-          default:
-        {errormessage(BOOTERR,WRONGFAT);exit(1);break;};
-        };
+   cl = get_fat_value(selfentry,fatlength,fatnumber,fatptr2);
    printf("fatentry (memory) : $(%5x)            fatentry-value (memory) : $(%5x)\n",
       st_fat_entry,st_fat_value);
    printf("fatentry          : $(%5x)->$(%5x)  direntry->startcluster  : $(%5x)\n",
-      selfentry,cl,(*dirptr2).startcluster);
+      selfentry,cl,STARTCLUSTER(dirptr2));
    printf("->$(%4x):",seldentry);
    display_direntry(!0,dirptr2);
+   if ((ownerdir != NULL) && ((unsigned int)selfentry < (unsigned int)clusters) &&
+       (ownerdir[selfentry] != NOOWNER))
+    { printf("owner of fatentry : $(%4x) %.8s.%.3s, cluster %u of the chain\n",
+         ownerdir[selfentry],(dirptr2 - seldentry + ownerdir[selfentry])->filename,
+         (dirptr2 - seldentry + ownerdir[selfentry])->extension,
+         ownerpos[selfentry]);
+    }
+   else
+    { printf("owner of fatentry : <none>\n");
+    };
+   if (classmap != NULL)
+    { printf("content of fatentry : %s\n",classnames[cluster_class(selfentry)]);
+    };
  printf("**************************************************************************\n");
    printf("0 = exit this menu\n");
    printf("1 = select fatentry\n");
@@ -960,6 +2108,11 @@ int show_fat_options(selfentry,seldentry,fatlength,fatnumber,fatptr2,dirptr2)
    printf("C = (copy) fatentry value := saved fatentry \n");
    printf("R = (restore) fatentry value := saved fatentry value\n");
    printf("F = (follow) fatentry := fatentry value\n");
+   printf("O = goto owner direntry of fatentry\n");
+   printf("L = link fatentry...last cluster into a chain\n");
+   printf("T = goto next free text cluster\n");
+   printf("G = suggest the next cluster of a text file\n");
+   printf("/ = search all clusters for a text or bytes\n");
    printf("**************************************************************************\n");
    c = getch();    /* ansi-c specific */
    c = toupper(c); /* for MSC, getch+toupper are not 
@@ -975,6 +2128,11 @@ int show_fat_options(selfentry,seldentry,fatlength,fatnumber,fatptr2,dirptr2)
       case 'P' : { c = 17;break;};
       case 'F' : { c = 18;break;};
       case 'S' : { c = 19;break;};
+      case 'O' : { c = 20;break;};
+      case 'L' : { c = 21;break;};
+      case 'T' : { c = 22;break;};
+      case 'G' : { c = 23;break;};
+      case '/' : { c = 24;break;};
 
       default  : {c = c - (int)'0'; break;};
     };
@@ -984,31 +2142,14 @@ int show_fat_options(selfentry,seldentry,fatlength,fatnumber,fatptr2,dirptr2)
 void enter_fatentry(selfentry,fatlength,fatnumber,fatptr2)
  int selfentry, fatlength,fatnumber;
  fatentry_tp * fatptr2;
- { unsigned int entry,xentry;
+ { unsigned int entry;
    unsigned int error1;
    error1 = 0;
    printf("? new entry value : $");
-   switch (fattyp)
-    { case FAT12B:
-       { /* old value */
-         entry = get_fatentry12(selfentry,fatlength,fatnumber,fatptr2);
-         scanf("%x",&entry);
-         error1 =
-          put_fatentry12(entry,selfentry,fatlength,fatnumber,fatptr2);
-         break;};
-
-      case FAT16B:
-       { /* old value */
-         entry = get_fatentry16(selfentry,fatlength,fatnumber,
-             (fatentry16_tp *)fatptr2);
-         scanf("%x",&xentry);
-         error1 =
-         put_fatentry16(entry,selfentry,fatlength,fatnumber,
-                (fatentry16_tp *)fatptr2);
-         break;};
-      default:
-       {errormessage(BOOTERR,WRONGFAT);exit(1);break;};
-    };
+   /* old value */
+   entry = get_fat_value(selfentry,fatlength,fatnumber,fatptr2);
+   scanf("%x",&entry);
+   error1 = set_fat_value(entry,selfentry,fatlength,fatnumber,fatptr2);
    if (error1 == ERRCLUST)
     { errormessage(BOOTERR,WRONGFENTRY);
     };
@@ -1022,11 +2163,20 @@ void hex_view(drive,viptr2,btptr2)
  unsigned char *viptr2;
  bootsec_tp * btptr2;
 #endif
- { int i,fsector,k,first;
+ { int i,k,first,error1;
+   sector_tp fsector;
    unsigned char *viptr3;
    fsector = clustosec(fat_entry,btptr2);
-   if ((absread((int)(toupper(drive) - 'A'),(*btptr2).sectors_per_cluster,
-        fsector,viptr2)) != NULL)
+#ifdef IMGDISK
+   /* view the cluster within the mapping, without copying */
+   if ((viptr3 = absmap((int)(toupper(drive) - 'A'),
+        (*btptr2).sectors_per_cluster,fsector)) != NULL)
+      { viptr2 = viptr3; error1 = 0;}
+   else
+#endif
+   error1 = (cache_read((int)(toupper(drive) - 'A'),(*btptr2).sectors_per_cluster,
+        fsector,viptr2) != NULL);
+   if (error1)
       {errormessage(BOOTERR,SREADERR);}
    else
       { viptr3 = viptr2;
@@ -1066,10 +2216,22 @@ void ascii_view(drive,viptr2,btptr2)
  unsigned char *viptr2;
  bootsec_tp * btptr2;
 #endif
- { int i,fsector;
+ { int i,error1;
+   sector_tp fsector;
+#ifdef IMGDISK
+   unsigned char *viptr3;
+#endif
    fsector = clustosec(fat_entry,btptr2);
-   if ((absread((int)(toupper(drive) - 'A'),(*btptr2).sectors_per_cluster,
-        fsector,viptr2)) != NULL)
+#ifdef IMGDISK
+   /* view the cluster within the mapping, without copying */
+   if ((viptr3 = absmap((int)(toupper(drive) - 'A'),
+        (*btptr2).sectors_per_cluster,fsector)) != NULL)
+      { viptr2 = viptr3; error1 = 0;}
+   else
+#endif
+   error1 = (cache_read((int)(toupper(drive) - 'A'),(*btptr2).sectors_per_cluster,
+        fsector,viptr2) != NULL);
+   if (error1)
       {errormessage(BOOTERR,SREADERR);}
    else
       { for (i = 0;i < (secsize * (*btptr2).sectors_per_cluster);i++)
@@ -1085,47 +2247,3827 @@ void ascii_view(drive,viptr2,btptr2)
       };
  }
 
-int get_fat_value(selfentry,fatlength,fatnumber,fatptr2)
- int selfentry,fatlength,fatnumber;
- fatentry_tp * fatptr2;
- { int cl;
-   switch (fattyp)
-     { case FAT12B:
-     {cl = get_fatentry12(selfentry,fatlength,fatnumber,
-        fatptr2);break;}
-       case FAT16B:
-     {cl = get_fatentry16(selfentry,fatlength,fatnumber,
-        (fatentry16_tp *)fatptr2);break;}
-       default:
-     {errormessage(BOOTERR,WRONGFAT);exit(1);break;};
-     };
-   return(cl);
+int get_fat_value(selfentry,fatlength,fatnumber,fatptr2)
+ int selfentry,fatlength,fatnumber;
+ fatentry_tp * fatptr2;
+ { int cl;
+#ifdef FATSHADOW
+   /* the work FAT is decoded already */
+   if ((fatnumber == WORKFAT) && (fatshadow != NULL) &&
+       ((unsigned int)selfentry < (unsigned int)clusters))
+    { return(fatshadow[selfentry]);
+    };
+#endif
+   if (fatpaged)
+    { return(get_fatentry_paged(selfentry,fatlength,fatnumber));
+    };
+   switch (fattyp)
+     { case FAT12B:
+     {cl = get_fatentry12(selfentry,fatlength,fatnumber,
+        fatptr2);break;}
+       case FAT16B:
+     {cl = get_fatentry16(selfentry,fatlength,fatnumber,
+        (fatentry16_tp *)fatptr2);break;}
+       case FAT32B:
+     {cl = get_fatentry32(selfentry,fatlength,fatnumber,
+        (fatentry32_tp *)fatptr2);break;}
+       default:
+     {errormessage(BOOTERR,WRONGFAT);exit(1);break;};
+     };
+   return(cl);
+ }
+
+int wrong_fat_value(fvalue,selfentry)
+ unsigned int fvalue,selfentry;
+ { return((selfentry >= (unsigned int)clusters) ||
+          ((fvalue >= (unsigned int)clusters) &&
+           ((fattyp == FAT32B) ?
+            ((fvalue < RESCLUST32) || (fvalue > FAT32MASK)) :
+            (((fvalue < RESCLUST) || (fvalue > 0xFFFF)) &&
+             ((fattyp != FAT12B) || (fvalue < RESCLUST12) || (fvalue > 0xFFF))))));
+ }
+
+unsigned int set_fat_value(fvalue,selfentry,fatlength,fatnumber,fatptr2)
+ unsigned int fvalue;
+ int selfentry,fatlength,fatnumber;
+ fatentry_tp * fatptr2;
+ { unsigned int error1,oldvalue;
+   oldvalue = NOFAT;
+   if (fatnumber == WORKFAT)
+    { oldvalue = get_fat_value(selfentry,fatlength,fatnumber,fatptr2);
+    };
+   /* the same checks as with the FAT itself */
+   if ((fatpaged
+#ifdef FATSHADOW
+        || ((fatnumber == WORKFAT) && (fatshadow != NULL))
+#endif
+       ) && wrong_fat_value(fvalue,selfentry))
+    { return(ERRCLUST);
+    };
+#ifdef FATSHADOW
+   if ((fatnumber == WORKFAT) && (fatshadow != NULL))
+    { /* the FAT is modified by "flush_fatshadow" */
+      fatshadow[selfentry] = fvalue;
+      SETBIT(shadowdirty,selfentry);
+      note_fatentry(selfentry,fvalue);
+      owner_fatentry(selfentry,oldvalue,fvalue);
+      return(fvalue);
+    };
+#endif
+   if (fatpaged)
+    { error1 = put_fatentry_paged(fvalue,selfentry,fatlength,fatnumber);
+    }
+   else
+   switch (fattyp)
+    { case FAT12B:
+       { error1 =
+          put_fatentry12(fvalue,selfentry,fatlength,fatnumber,fatptr2);
+        break;}
+      case FAT16B:
+       { error1 =
+           put_fatentry16(fvalue,selfentry,fatlength,fatnumber,
+                (fatentry16_tp *)fatptr2);break;}
+      case FAT32B:
+       { error1 =
+           put_fatentry32(fvalue,selfentry,fatlength,fatnumber,
+                (fatentry32_tp *)fatptr2);break;}
+      default:
+       {errormessage(BOOTERR,WRONGFAT);exit(1);break;};
+    };
+   if ((fatnumber == WORKFAT) && (error1 != ERRCLUST))
+    { owner_fatentry(selfentry,oldvalue,fvalue);
+    };
+   return(error1);
+ }
+
+int put_fat_value(fvalue,selfentry,fatlength,fatnumber,fatptr2)
+ int fvalue,selfentry,fatlength,fatnumber;
+ fatentry_tp * fatptr2;
+ { int error1;
+   int c;
+   error1 = 0;
+   printf("Do You really want to modify the FAT ? Y/N ");
+   c = getch();
+   printf("\n");
+   if (toupper(c)=='Y')
+    { error1 = set_fat_value(fvalue,selfentry,fatlength,fatnumber,fatptr2);
+    };
+   return(error1);
+ }
+
+#ifdef FATSHADOW
+int build_fatshadow(fatlength,fatptr2)
+ int fatlength;
+ fatentry_tp * fatptr2;
+ { unsigned int i;
+   free(fatshadow); free(shadowdirty);
+   fatshadow = NULL; shadowdirty = NULL;
+   if (fatpaged)
+    { /* a paged FAT is decoded entry by entry */
+      return(!0);
+    };
+   shadowdirty = calloc(BITMAPSIZE(clusters) + 1,1);
+   if (shadowdirty != NULL)
+    { /* +1 : the last pair of a 12-bit FAT */
+      fatshadow = calloc(clusters + 1,sizeof(unsigned int));
+    };
+   if (fatshadow == NULL)
+    { /* then just the FAT itself is used */
+      free(shadowdirty); shadowdirty = NULL;
+      return(!0);
+    };
+   switch (fattyp)
+    { case FAT12B:
+       { /* whole pairs, as far as the FAT reaches */
+         i = ((unsigned int)clusters + 1) >> 1;
+         if (i > (unsigned int)(fatlength * secsize) / 3)
+          { i = (unsigned int)(fatlength * secsize) / 3;
+          };
+         unpack_fat12(fatptr2,fatshadow,i);
+         break;}
+      case FAT16B:
+       { for (i = 0;i < (unsigned int)clusters;i++)
+          { fatshadow[i] = get_fatentry16(i,fatlength,WORKFAT,
+                          (fatentry16_tp *)fatptr2);
+          };
+         break;}
+      case FAT32B:
+       { for (i = 0;i < (unsigned int)clusters;i++)
+          { fatshadow[i] = get_fatentry32(i,fatlength,WORKFAT,
+                          (fatentry32_tp *)fatptr2);
+          };
+         break;}
+      default:
+       {errormessage(BOOTERR,WRONGFAT);exit(1);break;};
+    };
+   return(0);
+ }
+
+void flush_fatshadow(fatlength,fatptr2)
+ int fatlength;
+ fatentry_tp * fatptr2;
+ { unsigned int i;
+   if (fatshadow == NULL)
+    { return;
+    };
+   for (i = 0;i < (unsigned int)clusters;i++)
+    { if (TESTBIT(shadowdirty,i))
+       { switch (fattyp)
+          { case FAT12B:
+             { /* the whole pair, the values are checked already */
+               i &= ~1;
+               pack_fat12(&fatshadow[i],fatptr2 + (i >> 1),1);
+               mark_fatbytes((i >> 1) * 3,3,fatlength,WORKFAT);
+               CLRBIT(shadowdirty,i + 1);
+               break;}
+            case FAT16B:
+             {put_fatentry16(fatshadow[i],i,fatlength,WORKFAT,
+                            (fatentry16_tp *)fatptr2);break;}
+            case FAT32B:
+             {put_fatentry32(fatshadow[i],i,fatlength,WORKFAT,
+                            (fatentry32_tp *)fatptr2);break;}
+            default:
+             {errormessage(BOOTERR,WRONGFAT);exit(1);break;};
+          };
+         CLRBIT(shadowdirty,i);
+       };
+    };
+ }
+#endif
+
+#ifdef BTEST
+void benchmark_fat12(fatptr2,btptr2)
+ fatsec_tp *fatptr2;
+ bootsec_tp *btptr2;
+ { unsigned int i,npairs,loop,errors;
+   int fatlength;
+   unsigned int *values;
+   unsigned char *scratch,*dirtysave;
+   clock_t t0,t1,t2,t3,t4;
+   if (fatpaged)
+    { errormessage(FATALERR,NOTIMPL);
+      return;
+    };
+   fatlength = FATLENGTH(btptr2);
+   npairs = (unsigned int)(fatlength * secsize) / 3;
+   values = calloc(2 * npairs,sizeof(unsigned int));
+   scratch = calloc(fatlength,secsize);
+   dirtysave = calloc(BITMAPSIZE(fatsecs) + 1,1);
+   if ((values == NULL) || (scratch == NULL) || (dirtysave == NULL))
+    { free(values); free(scratch); free(dirtysave);
+      errormessage(FATALERR,NOMEM);
+      return;
+    };
+   /* "put_fatentry12" marks the sectors of FAT 0 */
+   memcpy(dirtysave,fatdirty,BITMAPSIZE(fatsecs) + 1);
+   memcpy(scratch,fatptr2,fatlength * secsize);
+   printf("%u entries, %d loops each\n",npairs << 1,BENCHLOOPS);
+   t0 = clock();
+   for (loop = 0;loop < BENCHLOOPS;loop++)
+    { for (i = 0;i < (npairs << 1);i++)
+       { values[i] = get_fatentry12(i,fatlength,WORKFAT,
+                                    (dfatentry12_tp *)fatptr2);
+       };
+    };
+   t1 = clock();
+   for (loop = 0;loop < BENCHLOOPS;loop++)
+    { unpack_fat12((dfatentry12_tp *)fatptr2,values,npairs);
+    };
+   t2 = clock();
+   for (loop = 0;loop < BENCHLOOPS;loop++)
+    { for (i = 0;i < (npairs << 1);i++)
+       { put_fatentry12(values[i],i,fatlength,0,(dfatentry12_tp *)scratch);
+       };
+    };
+   t3 = clock();
+   for (loop = 0;loop < BENCHLOOPS;loop++)
+    { pack_fat12(values,(dfatentry12_tp *)scratch,npairs);
+    };
+   t4 = clock();
+   memcpy(fatdirty,dirtysave,BITMAPSIZE(fatsecs) + 1);
+   /* both ways must give the same results */
+   errors = 0;
+   for (i = 0;i < (npairs << 1);i++)
+    { if (values[i] != get_fatentry12(i,fatlength,WORKFAT,
+                                      (dfatentry12_tp *)fatptr2))
+       { errors++; };
+    };
+   if (memcmp(scratch,fatptr2,npairs * 3) != 0)
+    { errors++; };
+   printf("get_fatentry12 loop : %8.2f ms\n",
+          (double)(t1 - t0) * 1000.0 / CLOCKS_PER_SEC);
+   printf("unpack_fat12        : %8.2f ms\n",
+          (double)(t2 - t1) * 1000.0 / CLOCKS_PER_SEC);
+   printf("put_fatentry12 loop : %8.2f ms\n",
+          (double)(t3 - t2) * 1000.0 / CLOCKS_PER_SEC);
+   printf("pack_fat12          : %8.2f ms\n",
+          (double)(t4 - t3) * 1000.0 / CLOCKS_PER_SEC);
+   printf("differences         : %u\n",errors);
+   free(values); free(scratch); free(dirtysave);
+ }
+
+void benchmark_chains()
+ { int widths[3];
+   int savetyp,saveclusters,savepaged,w,fatlength,loop;
+   unsigned int i,cl,entries,loopstart,*values;
+   unsigned char *scratch;
+#ifdef FATSHADOW
+   unsigned int *saveshadow;
+#endif
+   long links1,links2;
+   clock_t t0,t1,t2;
+   widths[0] = FAT12B; widths[1] = FAT16B; widths[2] = FAT32B;
+   /* a test FAT in memory instead of the FAT of the disk */
+   savetyp = fattyp; saveclusters = clusters; savepaged = fatpaged;
+   fatpaged = 0;
+#ifdef FATSHADOW
+   saveshadow = fatshadow; fatshadow = NULL;
+#endif
+   /* a chain 2->3->...->EOF, as long as a 12-bit FAT allows */
+   entries = RESCLUST12 - 16;
+   for (w = 0;w < 3;w++)
+    { fattyp = widths[w];
+      clusters = (int)entries;
+      fatlength = (int)(((long)entries * fattyp / 8 + secsize - 1) / secsize);
+      values = calloc(entries,sizeof(unsigned int));
+      scratch = calloc(fatlength,secsize);
+      if ((values == NULL) || (scratch == NULL))
+       { free(values); free(scratch);
+         errormessage(FATALERR,NOMEM);
+         break;
+       };
+      for (i = 2;i < entries;i++)
+       { values[i] = i + 1;
+       };
+      values[entries - 1] = (fattyp == FAT12B) ? 0xFFF :
+                            ((fattyp == FAT16B) ? 0xFFFF : FAT32MASK);
+      for (i = 0;i < entries;i++)
+       { switch (fattyp)
+          { case FAT12B:
+             { if ((i % 2) == 0)
+                { pack_fat12(&values[i],(dfatentry12_tp *)scratch + (i >> 1),1);
+                };
+               break;}
+            case FAT16B:
+             { *((fatentry16_tp *)scratch + i) = (fatentry16_tp)values[i];
+               break;}
+            default:
+             { *((fatentry32_tp *)scratch + i) = (fatentry32_tp)values[i];
+               break;}
+          };
+       };
+      links1 = 0; links2 = 0;
+      t0 = clock();
+      for (loop = 0;loop < BENCHLOOPS;loop++)
+       { for (cl = 2;ISCLUSTER(cl);
+              cl = get_fat_value(cl,fatlength,WORKFAT,(fatentry_tp *)scratch))
+          { links1++;
+          };
+       };
+      t1 = clock();
+      for (loop = 0;loop < BENCHLOOPS;loop++)
+       { links2 += chain_length(2,fatlength,WORKFAT,(fatentry_tp *)scratch,
+                                &loopstart);
+       };
+      t2 = clock();
+      printf("%2d-bit FAT, %ld links : get_fat_value %8.2f ns/link, "
+             "chain_length %8.2f ns/link\n",fattyp,links1 / BENCHLOOPS,
+             (double)(t1 - t0) * 1.0e9 / CLOCKS_PER_SEC / links1,
+             (double)(t2 - t1) * 1.0e9 / CLOCKS_PER_SEC / links2);
+      free(values); free(scratch);
+    };
+   fattyp = savetyp; clusters = saveclusters; fatpaged = savepaged;
+#ifdef FATSHADOW
+   fatshadow = saveshadow;
+#endif
+ }
+#endif
+
+/* free space index */
+
+void free_leaf(leaf)
+ unsigned int leaf;
+ { unsigned int w,b,node,run;
+   node = freeleaves + leaf;
+   w = freemap[leaf];
+   freecnt[node] = 0; freepre[node] = 0; freemax[node] = 0;
+   run = 0;
+   for (b = 0;b < FREEBITS;b++)
+    { if ((w >> b) & 1)
+       { freecnt[node]++;
+         run++;
+         if (freepre[node] == b) { freepre[node]++; };
+         if (run > freemax[node]) { freemax[node] = run; };
+       }
+      else
+       { run = 0; };
+    };
+   freesuf[node] = run;
+ }
+
+void free_join(node,half)
+ unsigned int node,half;
+ { unsigned int l,r,m;
+   l = node << 1; r = l + 1;
+   freecnt[node] = freecnt[l] + freecnt[r];
+   freepre[node] = (freepre[l] == half) ? half + freepre[r] : freepre[l];
+   freesuf[node] = (freesuf[r] == half) ? half + freesuf[l] : freesuf[r];
+   /* the longest free run is left, right or across the middle */
+   m = freesuf[l] + freepre[r];
+   if (freemax[l] > m) { m = freemax[l]; };
+   if (freemax[r] > m) { m = freemax[r]; };
+   freemax[node] = m;
+ }
+
+int build_freeindex(fatlength,fatptr2)
+ int fatlength;
+ fatentry_tp * fatptr2;
+ { unsigned int i,k,n,nwords,first,half;
+   unsigned int block[FATBLOCK];
+   free(freemap); free(freecnt); free(freepre); free(freesuf); free(freemax);
+   freemap = NULL;
+   nwords = ((unsigned int)clusters + FREEBITS - 1) / FREEBITS;
+   for (freeleaves = 1;freeleaves < nwords;freeleaves <<= 1) {};
+   freecnt = calloc(freeleaves << 1,sizeof(unsigned int));
+   freepre = calloc(freeleaves << 1,sizeof(unsigned int));
+   freesuf = calloc(freeleaves << 1,sizeof(unsigned int));
+   freemax = calloc(freeleaves << 1,sizeof(unsigned int));
+   if ((freecnt != NULL) && (freepre != NULL) &&
+       (freesuf != NULL) && (freemax != NULL))
+    { /* unused words of the last leaves stay "used" */
+      freemap = calloc(freeleaves,sizeof(unsigned int));
+    };
+   if (freemap == NULL)
+    { free(freecnt); free(freepre); free(freesuf); free(freemax);
+      freecnt = NULL; freepre = NULL; freesuf = NULL; freemax = NULL;
+      return(!0);
+    };
+   /* cluster 0 and 1 are never free */
+   for (i = 2;i < (unsigned int)clusters;i += n)
+    { n = (unsigned int)clusters - i;
+      n = decode_fats(i,(n < FATBLOCK) ? n : FATBLOCK,fatlength,WORKFAT,
+                      fatptr2,block);
+      if (n == 0)
+       { break;
+       };
+      for (k = 0;k < n;k++)
+       { if (block[k] == NOFAT)
+          { freemap[(i + k) / FREEBITS] |= 1 << ((i + k) % FREEBITS);
+          };
+       };
+    };
+   for (i = 0;i < freeleaves;i++)
+    { free_leaf(i);
+    };
+   half = FREEBITS;
+   for (first = freeleaves >> 1;first > 0;first >>= 1)
+    { for (i = first;i < (first << 1);i++)
+       { free_join(i,half);
+       };
+      half <<= 1;
+    };
+   return(0);
+ }
+
+void note_fatentry(index,value)
+ unsigned int index,value;
+ { unsigned int leaf,bit,node,half;
+   if ((freemap == NULL) || (index < 2) || (index >= (unsigned int)clusters))
+    { return;
+    };
+   leaf = index / FREEBITS;
+   bit = 1 << (index % FREEBITS);
+   if (((freemap[leaf] & bit) != 0) == (value == NOFAT))
+    { return;
+    };
+   freemap[leaf] ^= bit;
+   free_leaf(leaf);
+   half = FREEBITS;
+   for (node = (freeleaves + leaf) >> 1;node > 0;node >>= 1)
+    { free_join(node,half);
+      half <<= 1;
+    };
+ }
+
+unsigned int first_free_run(n)
+ unsigned int n;
+ { unsigned int node,base,half,run,b;
+   if ((freemap == NULL) || (n == 0) || (freemax[1] < n))
+    { return(NOFAT);
+    };
+   node = 1; base = 0;
+   half = FREEBITS * (freeleaves >> 1);
+   while (node < freeleaves)
+    { if (freemax[node << 1] >= n)
+       { node = node << 1;
+       }
+      else
+       { if (freesuf[node << 1] + freepre[(node << 1) + 1] >= n)
+          { return(base + half - freesuf[node << 1]);
+          };
+         node = (node << 1) + 1;
+         base += half;
+       };
+      half >>= 1;
+    };
+   /* within the 16 clusters of the leaf */
+   run = 0;
+   for (b = 0;b < FREEBITS;b++)
+    { if ((freemap[node - freeleaves] >> b) & 1)
+       { if (++run >= n)
+          { return(base + b + 1 - n);
+          };
+       }
+      else
+       { run = 0; };
+    };
+   return(NOFAT);
+ }
+
+/* chain walker */
+
+/* The same loops for each FAT width, the width is selected just once
+   by "decode_fats" and "chain_length", so the decoding of the entries
+   may be inlined by the compiler */
+
+#define FATENGINE(w,ptr_tp,ENTRY) \
+unsigned int decode_fat##w(first,count,entries,fatlength,fatnumber,p,dst) \
+ unsigned int first,count,entries; \
+ int fatlength,fatnumber; \
+ ptr_tp p; \
+ unsigned int *dst; \
+ { unsigned int i; \
+   /* not each width uses each of them */ \
+   (void)fatlength; (void)fatnumber; (void)p; \
+   if (first >= entries) \
+    { return(0); \
+    }; \
+   if (count > entries - first) \
+    { count = entries - first; \
+    }; \
+   for (i = 0;i < count;i++) \
+    { dst[i] = ENTRY(p,first + i); \
+    }; \
+   return(count); \
+ } \
+ \
+long chain_length##w(start,entries,fatlength,fatnumber,p,loopstart) \
+ unsigned int start,entries; \
+ int fatlength,fatnumber; \
+ ptr_tp p; \
+ unsigned int *loopstart; \
+ { unsigned int tortoise,hare; \
+   long n,power,lam,mu; \
+   (void)fatlength; (void)fatnumber; (void)p; \
+   *loopstart = NOFAT; \
+   if (!ISCLUSTER(start)) \
+    { return(0L); \
+    }; \
+   /* Brent: the tortoise waits at powers of 2 for the hare */ \
+   n = 1; power = 1; lam = 1; \
+   tortoise = start; \
+   hare = (start < entries) ? ENTRY(p,start) : ERRCLUST; \
+   while (hare != tortoise) \
+    { if (!ISCLUSTER(hare)) \
+       { return(n); \
+       }; \
+      n++; \
+      if (power == lam) \
+       { tortoise = hare; \
+         power <<= 1; \
+         lam = 0; \
+       }; \
+      hare = (hare < entries) ? ENTRY(p,hare) : ERRCLUST; \
+      lam++; \
+    }; \
+   /* loop of length "lam", find its first cluster, */ \
+   /* all its clusters are within the FAT */ \
+   tortoise = start; hare = start; \
+   for (n = 0;n < lam;n++) \
+    { hare = ENTRY(p,hare); \
+    }; \
+   mu = 0; \
+   while (tortoise != hare) \
+    { tortoise = ENTRY(p,tortoise); \
+      hare = ENTRY(p,hare); \
+      mu++; \
+    }; \
+   *loopstart = tortoise; \
+   return(mu + lam); \
+ }
+
+#define FATENTRYPG(p,i) get_fatentry_paged((i),fatlength,fatnumber)
+#define FATENTRYSH(p,i) ((p)[i])
+
+FATENGINE(12,unsigned char *,FATENTRY12)
+FATENGINE(16,unsigned char *,FATENTRY16)
+FATENGINE(32,unsigned char *,FATENTRY32)
+FATENGINE(pg,unsigned char *,FATENTRYPG)
+#ifdef FATSHADOW
+FATENGINE(sh,unsigned int *,FATENTRYSH)
+#endif
+
+unsigned int fat_entries(fatlength)
+ int fatlength;
+ { return((unsigned int)(((unsigned long)fatlength * secsize * 8) / fattyp));
+ }
+
+unsigned int decode_fats(first,count,fatlength,fatnumber,fatptr2,dst)
+ unsigned int first,count;
+ int fatlength,fatnumber;
+ fatentry_tp * fatptr2;
+ unsigned int *dst;
+ { unsigned char *p;
+   unsigned int n;
+#ifdef FATSHADOW
+   if ((fatnumber == WORKFAT) && (fatshadow != NULL))
+    { return(decode_fatsh(first,count,(unsigned int)clusters,
+                          fatlength,fatnumber,fatshadow,dst));
+    };
+#endif
+   if (fatpaged)
+    { return(decode_fatpg(first,count,fat_entries(fatlength),
+                          fatlength,fatnumber,NULL,dst));
+    };
+   p = (unsigned char *)fatptr2 + (long)fatlength * fatnumber * secsize;
+   switch (fattyp)
+    { case FAT12B:
+       {n = decode_fat12(first,count,fat_entries(fatlength),
+                         fatlength,fatnumber,p,dst);break;}
+      case FAT16B:
+       {n = decode_fat16(first,count,fat_entries(fatlength),
+                         fatlength,fatnumber,p,dst);break;}
+      case FAT32B:
+       {n = decode_fat32(first,count,fat_entries(fatlength),
+                         fatlength,fatnumber,p,dst);break;}
+      default:
+       {errormessage(BOOTERR,WRONGFAT);exit(1);break;};
+    };
+   return(n);
+ }
+
+long chain_length(start,fatlength,fatnumber,fatptr2,loopstart)
+ unsigned int start;
+ int fatlength,fatnumber;
+ fatentry_tp * fatptr2;
+ unsigned int *loopstart;
+ { unsigned char *p;
+   long n;
+#ifdef FATSHADOW
+   if ((fatnumber == WORKFAT) && (fatshadow != NULL))
+    { return(chain_lengthsh(start,(unsigned int)clusters,
+                            fatlength,fatnumber,fatshadow,loopstart));
+    };
+#endif
+   if (fatpaged)
+    { return(chain_lengthpg(start,fat_entries(fatlength),
+                            fatlength,fatnumber,NULL,loopstart));
+    };
+   p = (unsigned char *)fatptr2 + (long)fatlength * fatnumber * secsize;
+   switch (fattyp)
+    { case FAT12B:
+       {n = chain_length12(start,fat_entries(fatlength),
+                           fatlength,fatnumber,p,loopstart);break;}
+      case FAT16B:
+       {n = chain_length16(start,fat_entries(fatlength),
+                           fatlength,fatnumber,p,loopstart);break;}
+      case FAT32B:
+       {n = chain_length32(start,fat_entries(fatlength),
+                           fatlength,fatnumber,p,loopstart);break;}
+      default:
+       {errormessage(BOOTERR,WRONGFAT);exit(1);break;};
+    };
+   return(n);
+ }
+void display_chain(start,fatlength,fatnumber,fatptr2)
+ unsigned int start;
+ int fatlength,fatnumber;
+ fatentry_tp * fatptr2;
+ { long n;
+   unsigned int cl,loopstart;
+   n = chain_length(start,fatlength,fatnumber,fatptr2,&loopstart);
+   /* each cluster just once, then the end value,
+      the 28 bits of FAT32 need a wider field */
+   for (cl = start;n > 0;n--)
+    { printf((fattyp == FAT32B) ? " %8x" : "%5x",cl);
+      cl = get_fat_value(cl,fatlength,fatnumber,fatptr2);
+    };
+   if (loopstart != NOFAT)
+    { printf(" loop->%x\n",cl);
+    }
+   else
+    { printf((fattyp == FAT32B) ? " %8x\n" : "%5x\n",cl);
+    };
+ }
+
+/* cluster owner index */
+
+unsigned int own_next(cl)
+ unsigned int cl;
+ { return(get_fat_value(cl,FATLENGTH(btptr),WORKFAT,
+                        (fatentry_tp *)fatptr));
+ }
+
+void own_link(cl,dentry,pos)
+ unsigned int cl;
+ int dentry;
+ unsigned int pos;
+ { /* up to the end of the chain, or up to an owned cluster ( loop ) */
+   while ((cl >= 2) && (cl < (unsigned int)clusters) &&
+          (ownerdir[cl] == NOOWNER))
+    { ownerdir[cl] = dentry;
+      ownerpos[cl] = pos++;
+      cl = own_next(cl);
+    };
+   if ((cl >= 2) && (cl < (unsigned int)clusters) && (ownerdir[cl] != dentry))
+    { SETBIT(crossmap,cl);
+    };
+ }
+
+int own_unlink(cl,dentry,pos)
+ unsigned int cl;
+ int dentry;
+ unsigned int pos;
+ { int crossed;
+   /* just the part of the chain from position "pos" on */
+   crossed = 0;
+   while ((cl >= 2) && (cl < (unsigned int)clusters) &&
+          (ownerdir[cl] == dentry) && (ownerpos[cl] >= pos))
+    { ownerdir[cl] = NOOWNER;
+      if (TESTBIT(crossmap,cl))
+       { crossed = !0;
+       };
+      cl = own_next(cl);
+    };
+   return(crossed);
+ }
+
+int build_ownerindex()
+ { unsigned int i;
+   int d;
+   struct direntry_tp *dirptr2;
+   free(ownerdir); free(ownerpos); free(ownerstart); free(crossmap);
+   ownerdir = NULL;
+   ownerdirs = DIRENTRIES(btptr);
+   ownerpos = calloc(clusters,sizeof(unsigned int));
+   ownerstart = calloc(ownerdirs + 1,sizeof(unsigned int));
+   crossmap = calloc(BITMAPSIZE(clusters) + 1,1);
+   if ((ownerpos != NULL) && (ownerstart != NULL) && (crossmap != NULL))
+    { ownerdir = calloc(clusters,sizeof(int));
+    };
+   if (ownerdir == NULL)
+    { free(ownerpos); free(ownerstart); free(crossmap);
+      ownerpos = NULL; ownerstart = NULL; crossmap = NULL;
+      return(!0);
+    };
+   for (i = 0;i < (unsigned int)clusters;i++)
+    { ownerdir[i] = NOOWNER;
+    };
+   for (d = 0;d < ownerdirs;d++)
+    { dirptr2 = dirptr + d;
+      ownerstart[d] = NOFAT;
+      if (((* dirptr2).filename[0] != 0x00) &&
+          ((* dirptr2).filename[0] != 0xE5))
+       { ownerstart[d] = STARTCLUSTER(dirptr2);
+         own_link(ownerstart[d],d,0);
+       };
+    };
+   return(0);
+ }
+
+void owner_fatentry(index,oldvalue,newvalue)
+ unsigned int index,oldvalue,newvalue;
+ { int d;
+   if ((ownerdir == NULL) || (index >= (unsigned int)clusters) ||
+       (oldvalue == newvalue) || (ownerdir[index] == NOOWNER))
+    { return;
+    };
+   d = ownerdir[index];
+   if (own_unlink(oldvalue,d,ownerpos[index] + 1))
+    { /* a released cluster belongs to another chain too */
+      build_ownerindex();
+      return;
+    };
+   own_link(newvalue,d,ownerpos[index] + 1);
+ }
+
+void owner_direntry(dirptr2)
+ struct direntry_tp *dirptr2;
+ { int d;
+   unsigned int start;
+   d = dirptr2 - dirptr;
+   if ((ownerdir == NULL) || (d < 0) || (d >= ownerdirs))
+    { return;
+    };
+   start = NOFAT;
+   if (((* dirptr2).filename[0] != 0x00) &&
+       ((* dirptr2).filename[0] != 0xE5))
+    { start = STARTCLUSTER(dirptr2);
+    };
+   if (start == ownerstart[d])
+    { return;
+    };
+   if (own_unlink(ownerstart[d],d,0))
+    { build_ownerindex();
+      return;
+    };
+   own_link(start,d,0);
+ }
+
+/* FAT check */
+
+unsigned int show_ranges(title,map)
+ char *title;
+ unsigned char *map;
+ { unsigned int i,first,n,runs;
+   n = 0; runs = 0;
+   printf("%s :",title);
+   for (i = 0;i < (unsigned int)clusters;i++)
+    { if (TESTBIT(map,i))
+       { /* compact: one range for each run of clusters */
+         first = i;
+         while (((i + 1) < (unsigned int)clusters) && TESTBIT(map,i + 1))
+          { i++; };
+         if (first == i)
+          { printf(" %x",first); }
+         else
+          { printf(" %x-%x",first,i); };
+         n += i - first + 1;
+         if ((++runs % 8) == 0) { printf("\n  "); };
+       };
+    };
+   printf(" ( %u clusters )\n",n);
+   return(n);
+ }
+
+void reach_chain(start,reach,fatlength,fatptr2)
+ unsigned int start;
+ unsigned char *reach;
+ int fatlength;
+ fatentry_tp * fatptr2;
+ { unsigned int cl;
+   /* up to the end of the chain, or up to a reached cluster ( loop ) */
+   for (cl = start;ISCLUSTER(cl) && !TESTBIT(reach,cl);
+        cl = get_fat_value(cl,fatlength,WORKFAT,fatptr2))
+    { SETBIT(reach,cl);
+    };
+ }
+
+void check_fat(fatptr2,btptr2,dirptr2)
+ fatsec_tp *fatptr2;
+ bootsec_tp *btptr2;
+ struct direntry_tp *dirptr2;
+ { unsigned int i,v,w,lastres,e,entries;
+   int fatlength,nd;
+   unsigned char *indeg,*cross,*lost,*heads,*badend,*reach;
+   struct direntry_tp *dp;
+   fatlength = FATLENGTH(btptr2);
+   lastres = (fattyp == FAT12B) ? RESCLUST12 :
+             ((fattyp == FAT32B) ? RESCLUST32 : RESCLUST);
+   indeg = calloc(clusters,1);
+   cross = calloc(BITMAPSIZE(clusters) + 1,1);
+   lost = calloc(BITMAPSIZE(clusters) + 1,1);
+   heads = calloc(BITMAPSIZE(clusters) + 1,1);
+   badend = calloc(BITMAPSIZE(clusters) + 1,1);
+   reach = calloc(BITMAPSIZE(clusters) + 1,1);
+   if ((indeg == NULL) || (cross == NULL) || (lost == NULL) ||
+       (heads == NULL) || (badend == NULL) || (reach == NULL))
+    { free(indeg); free(cross); free(lost); free(heads); free(badend);
+      free(reach);
+      errormessage(FATALERR,NOMEM);
+      return;
+    };
+   /* references by the main directory and by the subdirectories,
+      without "." and ".." */
+   refresh_dirtree(fatlength,(fatentry_tp *)fatptr2,btptr2);
+   for (nd = 0;nd < ((ndirnodes > 0) ? ndirnodes : 1);nd++)
+    { dp = (nd == MAINNODE) ? dirptr2 : node_dir(nd);
+      entries = (nd == MAINNODE) ? (unsigned int)DIRENTRIES(btptr2) : node_entries(nd);
+      for (e = 0;(e < entries) && (dp[e].filename[0] != 0x00);e++)
+       { if ((dp[e].filename[0] != 0xE5) && (dp[e].filename[0] != '.'))
+          { v = STARTCLUSTER(dp + e);
+            if ((v >= 2) && (v < (unsigned int)clusters) && (indeg[v] < 255))
+             { indeg[v]++; };
+            reach_chain(v,reach,fatlength,(fatentry_tp *)fatptr2);
+          };
+       };
+    };
+   if (fattyp == FAT32B)
+    { /* the main directory itself is a chain */
+      v = (unsigned int)(*btptr2).root_cluster;
+      if (ISCLUSTER(v) && (indeg[v] < 255))
+       { indeg[v]++; };
+      reach_chain(v,reach,fatlength,(fatentry_tp *)fatptr2);
+    };
+   /* in-degrees and chain ends, one pass over the FAT */
+   for (i = 2;i < (unsigned int)clusters;i++)
+    { v = get_fat_value(i,fatlength,WORKFAT,fatptr2);
+      if (v == NOFAT)
+       { continue; };
+      if ((v >= 2) && (v < (unsigned int)clusters))
+       { if (indeg[v] < 255) { indeg[v]++; };
+         w = get_fat_value(v,fatlength,WORKFAT,fatptr2);
+         if (w == NOFAT)
+          { /* links to a free cluster */
+            SETBIT(badend,i);
+          };
+       }
+      else
+       { if ((v < lastres) || (v > (lastres | 0x0F)))
+          { /* neither a cluster, nor a reserved value */
+            SETBIT(badend,i);
+          }
+         else
+          { if (v < (lastres | 0x07))
+             { /* reserved values, 0xFF7 is a bad cluster */
+               SETBIT(badend,i);
+             };
+          };
+       };
+    };
+   for (i = 2;i < (unsigned int)clusters;i++)
+    { if (indeg[i] > 1)
+       { SETBIT(cross,i); };
+      v = get_fat_value(i,fatlength,WORKFAT,fatptr2);
+      /* a bad cluster is neither free, nor part of a chain */
+      if ((v != NOFAT) && (v != (lastres | 0x07)))
+       { if (indeg[i] == 0)
+          { SETBIT(heads,i); };
+         if (!TESTBIT(reach,i))
+          { SETBIT(lost,i); };
+       };
+    };
+   show_ranges("cross-linked clusters    ",cross);
+   show_ranges("lost chain startclusters ",heads);
+   show_ranges("lost clusters            ",lost);
+   show_ranges("bad chain ends           ",badend);
+   free(indeg); free(cross); free(lost); free(heads); free(badend);
+   free(reach);
+ }
+
+int fat_plausibility(value,index,fatlength,fatnumber,fatptr2,refmap)
+ unsigned int value,index;
+ int fatlength,fatnumber;
+ fatentry_tp * fatptr2;
+ unsigned char *refmap;
+ { unsigned int lastres;
+   lastres = (fattyp == FAT12B) ? RESCLUST12 :
+             ((fattyp == FAT32B) ? RESCLUST32 : RESCLUST);
+   if (value == NOFAT)
+    { /* a free cluster must not be referenced */
+      return(TESTBIT(refmap,index) ? 0 : 2);
+    };
+   if (ISCLUSTER(value))
+    { if (value == index)
+       { return(0);
+       };
+      /* the chain goes on in the same FAT */
+      return((get_fat_value(value,fatlength,fatnumber,fatptr2) != NOFAT) ? 2 : 1);
+    };
+   if ((value >= (lastres | 0x08)) && (value <= (lastres | 0x0F)))
+    { /* the end of a chain, which begins somewhere */
+      return(TESTBIT(refmap,index) ? 2 : 1);
+    };
+   if (value == (lastres | 0x07))
+    { /* bad cluster */
+      return(1);
+    };
+   return(0);
+ }
+
+void compare_fats(fatptr2,btptr2,dirptr2)
+ fatsec_tp *fatptr2;
+ bootsec_tp *btptr2;
+ struct direntry_tp *dirptr2;
+ { unsigned int i,j,n,v,cnt,mapsize,changed,*values,*ndiff;
+   int nf,fatlength,k,d,c,best,votes,bestvotes,score,bestscore,sectors;
+   unsigned char *diff,*refmaps;
+   fatlength = FATLENGTH(btptr2);
+   nf = (* btptr2).number_of_fats;
+   if (nf < 2)
+    { errormessage(BOOTERR,WFATNUM);
+      return;
+    };
+   mapsize = BITMAPSIZE(clusters) + 1;
+   values = calloc(nf * FATBLOCK,sizeof(unsigned int));
+   ndiff = calloc(nf,sizeof(unsigned int));
+   diff = calloc(mapsize,1);
+   refmaps = calloc(nf,mapsize);
+   if ((values == NULL) || (ndiff == NULL) || (diff == NULL) || (refmaps == NULL))
+    { free(values); free(ndiff); free(diff); free(refmaps);
+      errormessage(FATALERR,NOMEM);
+      return;
+    };
+   /* decode all FATs block by block, compare whole blocks
+      with the work FAT, and single entries just in different blocks */
+   for (i = 0;i < (unsigned int)clusters;i += FATBLOCK)
+    { cnt = (unsigned int)clusters - i;
+      if (cnt > FATBLOCK) { cnt = FATBLOCK; };
+      for (k = 0;k < nf;k++)
+       { n = decode_fats(i,cnt,fatlength,k,(fatentry_tp *)fatptr2,
+                         values + k * FATBLOCK);
+         for (j = n;j < cnt;j++)
+          { values[k * FATBLOCK + j] = ERRCLUST; };
+         for (j = 0;j < cnt;j++)
+          { v = values[k * FATBLOCK + j];
+            if (ISCLUSTER(v))
+             { SETBIT(refmaps + k * mapsize,v); };
+          };
+         if ((k > 0) &&
+             (memcmp(values,values + k * FATBLOCK,cnt * sizeof(unsigned int)) != 0))
+          { for (j = 0;j < cnt;j++)
+             { if (values[j] != values[k * FATBLOCK + j])
+                { SETBIT(diff,i + j);
+                  ndiff[k]++;
+                };
+             };
+          };
+       };
+    };
+   /* the startclusters are referenced by the main directory */
+   for (d = 0;d < DIRENTRIES(btptr2);d++)
+    { if (((* (dirptr2 + d)).filename[0] != 0x00) &&
+          ((* (dirptr2 + d)).filename[0] != 0xE5) &&
+          ISCLUSTER(STARTCLUSTER(dirptr2 + d)))
+       { for (k = 0;k < nf;k++)
+          { SETBIT(refmaps + k * mapsize,STARTCLUSTER(dirptr2 + d)); };
+       };
+    };
+   if ((fattyp == FAT32B) && ISCLUSTER((unsigned int)(*btptr2).root_cluster))
+    { for (k = 0;k < nf;k++)
+       { SETBIT(refmaps + k * mapsize,(unsigned int)(*btptr2).root_cluster); };
+    };
+   for (k = 1;k < nf;k++)
+    { printf("FAT %d : %u entries differ from FAT 0\n",k,ndiff[k]);
+    };
+   if (show_ranges("different FAT entries    ",diff) > 0)
+    { printf("Do You want to repair the work FAT by %s ? Y/N ",
+             (nf > 2) ? "majority vote" : "plausibility");
+      c = getch();
+      printf("\n");
+      if (toupper(c) == 'Y')
+       { changed = 0;
+         for (i = 0;i < (unsigned int)clusters;i += FATBLOCK)
+          { cnt = (unsigned int)clusters - i;
+            if (cnt > FATBLOCK) { cnt = FATBLOCK; };
+            for (j = 0;(j < cnt) && !TESTBIT(diff,i + j);j++)
+             { };
+            if (j == cnt)
+             { continue; };
+            for (k = 0;k < nf;k++)
+             { n = decode_fats(i,cnt,fatlength,k,(fatentry_tp *)fatptr2,
+                               values + k * FATBLOCK);
+               for (j = n;j < cnt;j++)
+                { values[k * FATBLOCK + j] = ERRCLUST; };
+             };
+            for (j = 0;j < cnt;j++)
+             { if (!TESTBIT(diff,i + j))
+                { continue; };
+               /* the value of the most FATs */
+               best = 0; bestvotes = 0;
+               for (c = 0;c < nf;c++)
+                { votes = 0;
+                  for (k = 0;k < nf;k++)
+                   { if (values[k * FATBLOCK + j] == values[c * FATBLOCK + j])
+                      { votes++; };
+                   };
+                  if (votes > bestvotes)
+                   { best = c; bestvotes = votes; };
+                };
+               if ((bestvotes << 1) <= nf)
+                { /* no majority, then the most plausible value,
+                     the work FAT wins a tie */
+                  best = 0;
+                  bestscore = fat_plausibility(values[j],i + j,fatlength,0,
+                                               (fatentry_tp *)fatptr2,refmaps);
+                  for (c = 1;c < nf;c++)
+                   { score = fat_plausibility(values[c * FATBLOCK + j],i + j,
+                                              fatlength,c,(fatentry_tp *)fatptr2,
+                                              refmaps + c * mapsize);
+                     if (score > bestscore)
+                      { best = c; bestscore = score; };
+                   };
+                };
+               if ((values[best * FATBLOCK + j] != values[j]) &&
+                   (set_fat_value(values[best * FATBLOCK + j],i + j,fatlength,
+                                  WORKFAT,(fatentry_tp *)fatptr2) != ERRCLUST))
+                { changed++; };
+             };
+          };
+         /* then all FATs are the same again */
+         sectors = 0;
+         for (k = 1;k < nf;k++)
+          { if ((d = copy_fat(k,fatptr2,btptr2)) >= 0)
+             { sectors += d; };
+          };
+         printf("%u entries of the work FAT repaired, "
+                "%d sectors of the other FATs changed\n",changed,sectors);
+       };
+    };
+   free(values); free(ndiff); free(diff); free(refmaps);
+ }
+
+void link_run(first,fatlength,fatptr2,btptr2,dirptr2)
+ unsigned int first;
+ int fatlength;
+ fatentry_tp * fatptr2;
+ bootsec_tp *btptr2;
+ struct direntry_tp *dirptr2;
+ { unsigned int i,last,used,eof;
+   long laenge;
+   int c;
+   last = first;
+   printf("? last cluster of the chain : $");
+   /* without the end of the line, which is not an answer */
+   scanf("%x%*c",&last);
+   if (!ISCLUSTER(first) || !ISCLUSTER(last) || (last < first))
+    { errormessage(BOOTERR,WRONGFENTRY);
+      return;
+    };
+   eof = (fattyp == FAT12B) ? (RESCLUST12 | 0x0F) :
+         ((fattyp == FAT32B) ? (unsigned int)(RESCLUST32 | 0x0F) : (RESCLUST | 0x0F));
+   used = 0;
+   for (i = first;i <= last;i++)
+    { if (get_fat_value(i,fatlength,WORKFAT,fatptr2) != NOFAT)
+       { used++; };
+    };
+   printf("$(%x)...$(%x) : %u clusters, %u of them are not free\n",
+          first,last,last - first + 1,used);
+   printf("Do You really want to modify the FAT ? Y/N ");
+   c = getch();
+   printf("\n");
+   if (toupper(c) != 'Y')
+    { return;
+    };
+   /* each cluster links to the next one, the last one is the end */
+   for (i = first;i < last;i++)
+    { set_fat_value(i + 1,i,fatlength,WORKFAT,fatptr2);
+    };
+   set_fat_value(eof,last,fatlength,WORKFAT,fatptr2);
+   printf("Do You want to link the direntry to the chain ? Y/N ");
+   c = getch();
+   printf("\n");
+   if (toupper(c) == 'Y')
+    { laenge = (long)(last - first + 1) * (long)(*btptr2).sectors_per_cluster *
+               (long)(*btptr2).bytes_per_sector;
+      printf("? filelength : $");
+      scanf("%lx",&laenge);
+      (* dirptr2).startcluster = (word_tp)(first & 0xFFFF);
+      if (fattyp == FAT32B)
+       { (* dirptr2).startcluster_high = (word_tp)((unsigned long)first >> 16);
+       };
+      (* dirptr2).filelength = laenge;
+      mark_direntry(dirptr2);
+    };
+ }
+
+/*********************/
+/* cluster contents  */
+/*********************/
+
+unsigned char *get_clusters(cl,n,buffer,btptr2)
+ unsigned int cl,n;
+ unsigned char *buffer;
+ bootsec_tp *btptr2;
+ { int nsects;
+   sector_tp fsector;
+   unsigned char *data;
+   nsects = (int)n * (*btptr2).sectors_per_cluster;
+   fsector = clustosec(cl,btptr2);
+#ifdef IMGDISK
+   /* within the mapping, without copying */
+   if ((data = absmap((int)(toupper(drive) - 'A'),nsects,fsector)) != NULL)
+    { return(data);
+    };
+#endif
+   data = buffer;
+   if (absread((int)(toupper(drive) - 'A'),nsects,fsector,buffer) != 0)
+    { data = NULL;
+    };
+   return(data);
+ }
+
+int classify_cluster(data,nbytes)
+ unsigned char *data;
+ unsigned int nbytes;
+ { unsigned int i,end,other,f6;
+   /* zeros at the end are the rest of the last cluster of a file */
+   for (end = nbytes;(end > 0) && (data[end - 1] == 0x00);end--)
+    { };
+   if (end == 0)
+    { return(CLZERO);
+    };
+   other = 0; f6 = 0;
+   for (i = 0;i < end;i++)
+    { if (data[i] == 0xF6)
+       { f6++; };
+      /* printable, TAB, LF, CR, CTRL-Z and the codepage 437 letters */
+      if (((data[i] < 0x20) && (data[i] != 0x09) && (data[i] != 0x0A) &&
+           (data[i] != 0x0D) && (data[i] != 0x1A)) ||
+          (data[i] == 0x7F) || (data[i] > 0xA8))
+       { other++; };
+    };
+   if (f6 == nbytes)
+    { return(CLF6);
+    };
+   return((other <= (end >> 5)) ? CLTEXT : CLBINARY);
+ }
+
+int build_classmap(btptr2)
+ bootsec_tp *btptr2;
+ { unsigned int cl,n,i,chunk,csize;
+   unsigned char *buffer,*data;
+   int cls;
+   free(classmap);
+   free_suggestindex();
+   classmap = calloc(((unsigned int)clusters >> 1) + 1,1);
+   csize = secsize * (*btptr2).sectors_per_cluster;
+   chunk = CLASSCHUNK / (*btptr2).sectors_per_cluster;
+   if (chunk < 1)
+    { chunk = 1;
+    };
+   buffer = malloc(chunk * csize);
+   if ((classmap == NULL) || (buffer == NULL))
+    { free(classmap); free(buffer);
+      classmap = NULL;
+      return(!0);
+    };
+   for (i = 0;i < CLASSES;i++)
+    { classcnt[i] = 0;
+    };
+   /* the data area in large pieces */
+   for (cl = 2;cl < (unsigned int)clusters;cl += n)
+    { n = (unsigned int)clusters - cl;
+      if (n > chunk) { n = chunk; };
+      data = get_clusters(cl,n,buffer,btptr2);
+      for (i = 0;i < n;i++)
+       { cls = (data == NULL) ? CLUNKNOWN :
+               classify_cluster(data + (long)i * csize,csize);
+         SETCLASS(cl + i,cls);
+         classcnt[cls]++;
+       };
+    };
+   free(buffer);
+   return(0);
+ }
+
+int cluster_class(cl)
+ unsigned int cl;
+ { if ((classmap == NULL) || !ISCLUSTER(cl))
+    { return(CLUNKNOWN);
+    };
+   return(GETCLASS(cl));
+ }
+
+unsigned int next_text_cluster(cl,fatlength,fatptr2)
+ unsigned int cl;
+ int fatlength;
+ fatentry_tp * fatptr2;
+ { unsigned int i;
+   for (i = cl + 1;i < (unsigned int)clusters;i++)
+    { if ((GETCLASS(i) == CLTEXT) &&
+          (get_fat_value(i,fatlength,WORKFAT,fatptr2) == NOFAT))
+       { return(i);
+       };
+    };
+   return(NOFAT);
+ }
+
+void show_classes(btptr2)
+ bootsec_tp *btptr2;
+ { unsigned char *map;
+   unsigned int cl;
+   int i;
+   if (build_classmap(btptr2) != 0)
+    { errormessage(FATALERR,NOMEM);
+      return;
+    };
+   for (i = 0;i < CLASSES;i++)
+    { printf("%-15s : %u clusters\n",classnames[i],classcnt[i]);
+    };
+   if ((map = calloc(BITMAPSIZE(clusters) + 1,1)) != NULL)
+    { for (cl = 2;cl < (unsigned int)clusters;cl++)
+       { if (GETCLASS(cl) == CLTEXT)
+          { SETBIT(map,cl); };
+       };
+      show_ranges("text clusters            ",map);
+      free(map);
+    };
+ }
+
+void text_features(data,nbytes,info)
+ unsigned char *data;
+ unsigned int nbytes;
+ struct textinfo_tp *info;
+ { unsigned int i,end,lines,linestart,code;
+   for (end = nbytes;(end > 0) && (data[end - 1] == 0x00);end--)
+    { };
+   (*info).full = (end == nbytes);
+   (*info).length = end;
+   /* the parts of a word at the start and at the end */
+   for (i = 0;(i < end) && (i < 255) && isalnum(data[i]);i++)
+    { };
+   (*info).headword = (unsigned char)i;
+   for (i = 0;(i < end) && (i < 255) && isalnum(data[end - 1 - i]);i++)
+    { };
+   (*info).tailword = (unsigned char)i;
+   (*info).first = data[0];
+   (*info).second = (end > 1) ? data[1] : 0;
+   (*info).last = (end > 0) ? data[end - 1] : 0;
+   (*info).prelast = (end > 1) ? data[end - 2] : 0;
+   /* the first line, which may be the rest of a line of the cluster before */
+   for (i = 0;(i < end) && (data[i] != '\n');i++)
+    { };
+   (*info).headline = (i > 0) && (data[i - 1] == '\r') ? i - 1 : i;
+   /* indentation of the first whole line */
+   for (i++,(*info).headindent = 0;(i < end) && (data[i] == ' ');i++)
+    { if ((*info).headindent < 255) { (*info).headindent++; }; };
+   /* average length of the lines, C syntax */
+   lines = 0; linestart = 0; code = 0;
+   for (i = 0;i < end;i++)
+    { if (data[i] == '\n')
+       { lines++; linestart = i + 1;
+       };
+      if ((data[i] == '{') || (data[i] == '}') || (data[i] == ';'))
+       { code++; };
+    };
+   (*info).avgline = (lines > 0) ? end / lines : end;
+   (*info).code = (code * 64 > end);
+   /* the last line, which may go on in the next cluster */
+   (*info).tailline = end - linestart;
+   for (i = linestart,(*info).tailindent = 0;(i < end) && (data[i] == ' ');i++)
+    { if ((*info).tailindent < 255) { (*info).tailindent++; }; };
+ }
+
+int text_score(a,b)
+ struct textinfo_tp *a,*b;
+ { int score;
+   unsigned int n;
+   score = 0;
+   /* the byte triples across the cluster border,
+      as often as within the text clusters */
+   if (gramtab != NULL)
+    { score += gram_weight(gramtab[GRAMHASH((*a).prelast,(*a).last,(*b).first)]);
+      score += gram_weight(gramtab[GRAMHASH((*a).last,(*b).first,(*b).second)]);
+    };
+   /* CR LF, divided by the cluster border */
+   if ((*a).last == '\r')
+    { score += ((*b).first == '\n') ? 4 : -4;
+    };
+   /* a word, divided by the cluster border */
+   if (isalnum((*a).last) && isalnum((*b).first))
+    { score += 2;
+      /* but no capital letter after a small one, no overlong word */
+      if (islower((*a).last) && isupper((*b).first))
+       { score -= 2;
+       };
+      if ((*a).tailword + (*b).headword > 24)
+       { score -= 2;
+       };
+    }
+   else if (isalnum((*a).last) && ((*b).first == ' '))
+    { score += 1;
+    };
+   /* both parts of the divided line have the usual length together */
+   n = (*a).tailline + (*b).headline;
+   if ((*a).avgline > 0)
+    { if (n <= (*a).avgline + ((*a).avgline >> 1) + 8)
+       { score += 2;
+       }
+      else if (n > ((*a).avgline << 1) + 16)
+       { score -= 2;
+       };
+    };
+   /* the next line is indented like the last one */
+   if (((*a).tailindent <= (*b).headindent + 4) &&
+       ((*b).headindent <= (*a).tailindent + 4))
+    { score += 1;
+    };
+   /* C source goes on with C source, prose with prose */
+   score += ((*a).code == (*b).code) ? 1 : -1;
+   /* DOS allocates the clusters of a file upwards, mostly the next one */
+   if ((*b).cluster == (*a).cluster + 1)
+    { score += 4;
+    }
+   else if (((*b).cluster > (*a).cluster) && ((*b).cluster - (*a).cluster <= 32))
+    { score += 1;
+    };
+   return(score);
+ }
+
+int gram_weight(count)
+ unsigned int count;
+ { /* relative to the average count, which grows with the text */
+   if (count == 0)
+    { return(-3);
+    };
+   if (count < (gramavg >> 2) + 1)
+    { return(-1);
+    };
+   if (count < (gramavg << 1))
+    { return(0);
+    };
+   return((count < (gramavg << 3)) ? 2 : 4);
+ }
+
+void count_grams(data,nbytes)
+ unsigned char *data;
+ unsigned int nbytes;
+ { unsigned int i,h;
+   for (;(nbytes > 0) && (data[nbytes - 1] == 0x00);nbytes--)
+    { };
+   for (i = 2;i < nbytes;i++)
+    { h = GRAMHASH(data[i - 2],data[i - 1],data[i]);
+      if (gramtab[h] < 0xFFFF)
+       { gramtab[h]++;
+       };
+      gramtotal++;
+    };
+ }
+
+unsigned int cluster_distance(i,j)
+ unsigned int i,j;
+ { /* DOS allocates the clusters of a file upwards */
+   return((j > i) ? textinfo[j].cluster - textinfo[i].cluster :
+          (unsigned int)clusters + textinfo[i].cluster - textinfo[j].cluster);
+ }
+
+void free_suggestindex()
+ { free(textinfo); free(suggest); free(suggestscore); free(gramtab);
+   textinfo = NULL; suggest = NULL; suggestscore = NULL; gramtab = NULL;
+   ntext = 0;
+ }
+
+int build_suggestindex(btptr2)
+ bootsec_tp *btptr2;
+ { unsigned int cl,i,j,k,b,f,csize,nbytes,scanned,*headorder;
+   unsigned int headstart[257];
+   int bound[256];
+   unsigned char order[256];
+   unsigned char *buffer,*data;
+   free_suggestindex();
+   if ((classmap == NULL) && (build_classmap(btptr2) != 0))
+    { return(!0);
+    };
+   for (cl = 2;cl < (unsigned int)clusters;cl++)
+    { if (GETCLASS(cl) == CLTEXT) { ntext++; };
+    };
+   csize = secsize * (*btptr2).sectors_per_cluster;
+   textinfo = calloc(ntext + 1,sizeof(struct textinfo_tp));
+   suggest = calloc((ntext + 1) * SUGGESTK,sizeof(unsigned int));
+   suggestscore = calloc((ntext + 1) * SUGGESTK,sizeof(int));
+   gramtab = calloc(GRAMSIZE,sizeof(unsigned int));
+   gramtotal = 0;
+   buffer = malloc(csize);
+   if ((textinfo == NULL) || (suggest == NULL) || (suggestscore == NULL) ||
+       (gramtab == NULL) || (buffer == NULL))
+    { free(buffer);
+      free_suggestindex();
+      return(!0);
+    };
+   /* the features of each text cluster, just once */
+   for (cl = 2,i = 0;cl < (unsigned int)clusters;cl++)
+    { if (GETCLASS(cl) == CLTEXT)
+       { textinfo[i].cluster = cl;
+         if ((data = get_clusters(cl,1,buffer,btptr2)) != NULL)
+          { text_features(data,csize,&textinfo[i]);
+            count_grams(data,csize);
+          };
+         i++;
+       };
+    };
+   free(buffer);
+   gramavg = (unsigned int)(gramtotal / GRAMSIZE);
+   /* the heads of the text clusters, by their first byte */
+   headorder = calloc(ntext + 1,sizeof(unsigned int));
+   if (headorder == NULL)
+    { free_suggestindex();
+      return(!0);
+    };
+   for (f = 0;f <= 256;f++)
+    { headstart[f] = 0;
+    };
+   for (i = 0;i < ntext;i++)
+    { headstart[textinfo[i].first + 1]++;
+    };
+   for (f = 0;f < 256;f++)
+    { headstart[f + 1] += headstart[f];
+    };
+   for (i = 0;i < ntext;i++)
+    { headorder[headstart[textinfo[i].first]++] = i;
+    };
+   for (f = 256;f > 0;f--)
+    { headstart[f] = headstart[f - 1];
+    };
+   headstart[0] = 0;
+   /* the best successors of each text cluster, which goes on */
+   for (i = 0;i < ntext;i++)
+    { for (k = 0;k < SUGGESTK;k++)
+       { suggest[i * SUGGESTK + k] = NOFAT;
+       };
+      if (!textinfo[i].full)
+       { continue;
+       };
+      /* at first the following clusters, they get the most points
+         by the allocation order */
+      for (j = i + 1;(j < ntext) &&
+           (textinfo[j].cluster - textinfo[i].cluster <= SUGGESTNEAR);j++)
+       { suggest_insert(i,j,text_score(&textinfo[i],&textinfo[j]));
+       };
+      /* then the first bytes, which give the most points, as long as
+         their upper bound may beat the SUGGESTK-th suggestion */
+      nbytes = 0;
+      for (f = 0;f < 256;f++)
+       { if (headstart[f + 1] > headstart[f])
+          { bound[f] = head_bound(&textinfo[i],f);
+            for (k = nbytes;(k > 0) && (bound[order[k - 1]] < bound[f]);k--)
+             { order[k] = order[k - 1];
+             };
+            order[k] = (unsigned char)f;
+            nbytes++;
+          };
+       };
+      scanned = 0;
+      for (k = 0;(k < nbytes) && (scanned < SUGGESTSCAN);k++)
+       { f = order[k];
+         if ((suggest[i * SUGGESTK + SUGGESTK - 1] != NOFAT) &&
+             (bound[f] < suggestscore[i * SUGGESTK + SUGGESTK - 1]))
+          { break;
+          };
+         for (b = headstart[f];(b < headstart[f + 1]) && (scanned < SUGGESTSCAN);b++)
+          { j = headorder[b];
+            if ((j == i) || ((j > i) &&
+                (textinfo[j].cluster - textinfo[i].cluster <= SUGGESTNEAR)))
+             { continue;
+             };
+            suggest_insert(i,j,text_score(&textinfo[i],&textinfo[j]));
+            scanned++;
+          };
+       };
+    };
+   free(headorder);
+   return(0);
+ }
+
+int head_bound(a,f)
+ struct textinfo_tp *a;
+ unsigned int f;
+ { int score;
+   /* the points of "text_score", which depend on the first byte,
+      and the most points of the other rules */
+   score = SUGGESTREST;
+   if (gramtab != NULL)
+    { score += gram_weight(gramtab[GRAMHASH((*a).prelast,(*a).last,f)]);
+    };
+   if ((*a).last == '\r')
+    { score += (f == '\n') ? 4 : -4;
+    };
+   if (isalnum((*a).last) && isalnum(f))
+    { score += (islower((*a).last) && isupper(f)) ? 0 : 2;
+    }
+   else if (isalnum((*a).last) && (f == ' '))
+    { score += 1;
+    };
+   return(score);
+ }
+
+void suggest_insert(i,j,score)
+ unsigned int i,j;
+ int score;
+ { unsigned int k;
+   /* insert into the sorted list, with the same score,
+      the nearest cluster after "i" comes first */
+   for (k = SUGGESTK;(k > 0) &&
+        ((suggest[i * SUGGESTK + k - 1] == NOFAT) ||
+         (suggestscore[i * SUGGESTK + k - 1] < score) ||
+         ((suggestscore[i * SUGGESTK + k - 1] == score) &&
+          (cluster_distance(i,j) <
+           cluster_distance(i,find_textinfo(suggest[i * SUGGESTK + k - 1])))));k--)
+    { if (k < SUGGESTK)
+       { suggest[i * SUGGESTK + k] = suggest[i * SUGGESTK + k - 1];
+         suggestscore[i * SUGGESTK + k] = suggestscore[i * SUGGESTK + k - 1];
+       };
+    };
+   if (k < SUGGESTK)
+    { suggest[i * SUGGESTK + k] = textinfo[j].cluster;
+      suggestscore[i * SUGGESTK + k] = score;
+    };
+ }
+
+int find_textinfo(cl)
+ unsigned int cl;
+ { unsigned int lo,hi,mid;
+   lo = 0; hi = ntext;
+   while (lo < hi)
+    { mid = (lo + hi) >> 1;
+      if (textinfo[mid].cluster < cl)
+       { lo = mid + 1; }
+      else
+       { hi = mid; };
+    };
+   return(((lo < ntext) && (textinfo[lo].cluster == cl)) ? (int)lo : -1);
+ }
+
+unsigned int suggest_next(selfentry,fatlength,fatptr2,btptr2)
+ unsigned int selfentry;
+ int fatlength;
+ fatentry_tp * fatptr2;
+ bootsec_tp *btptr2;
+ { int i,k,choice;
+   unsigned int cl;
+   if ((textinfo == NULL) && (build_suggestindex(btptr2) != 0))
+    { errormessage(FATALERR,NOMEM);
+      return(selfentry);
+    };
+   if (((i = find_textinfo(selfentry)) < 0) ||
+       (suggest[i * SUGGESTK] == NOFAT))
+    { errormessage(BOOTERR,NOSUGGESTERR);
+      return(selfentry);
+    };
+   for (k = 0;(k < SUGGESTK) && (suggest[i * SUGGESTK + k] != NOFAT);k++)
+    { cl = suggest[i * SUGGESTK + k];
+      printf("%d = $(%5x) score %3d %s\n",k + 1,cl,suggestscore[i * SUGGESTK + k],
+             (get_fat_value(cl,fatlength,WORKFAT,fatptr2) == NOFAT) ? "free" : "used");
+    };
+   choice = 0;
+   printf("? link fatentry to number ( 0 = none ) : ");
+   scanf("%d%*c",&choice);
+   if ((choice < 1) || (choice > k))
+    { return(selfentry);
+    };
+   cl = suggest[i * SUGGESTK + choice - 1];
+   if ((unsigned int)put_fat_value(cl,selfentry,fatlength,WORKFAT,fatptr2) == ERRCLUST)
+    { errormessage(BOOTERR,WRONGFENTRY);
+      return(selfentry);
+    };
+   /* follow the chain */
+   return(cl);
+ }
+
+void fill_direntry(dp,name,ext,attribute,start,length)
+ struct direntry_tp *dp;
+ char *name,*ext;
+ int attribute;
+ unsigned int start;
+ long length;
+ { char full[NLENGTH + ELENGTH + 1];
+   memset(dp,0,sizeof(struct direntry_tp));
+   sprintf(full,"%-8.8s%-3.3s",name,ext);
+   memcpy((*dp).filename,full,NLENGTH);
+   memcpy((*dp).extension,full + NLENGTH,ELENGTH);
+   (*dp).attribute = (unsigned char)attribute;
+   (*dp).day = 1; (*dp).month = 1;
+   (*dp).startcluster = (word_tp)(start & 0xFFFF);
+   if (fattyp == FAT32B)
+    { (*dp).startcluster_high = (word_tp)((unsigned long)start >> 16);
+    };
+   (*dp).filelength = length;
+ }
+
+struct direntry_tp *make_direntry(name,ext,start,length,btptr2,dirptr2)
+ char *name,*ext;
+ unsigned int start;
+ long length;
+ bootsec_tp *btptr2;
+ struct direntry_tp *dirptr2;
+ { int d;
+   struct direntry_tp *dp;
+   for (d = 0;d < DIRENTRIES(btptr2);d++)
+    { dp = dirptr2 + d;
+      if (((*dp).filename[0] == 0x00) || ((*dp).filename[0] == 0xE5))
+       { fill_direntry(dp,name,ext,0x20,start,length);
+         mark_direntry(dp);
+         return(dp);
+       };
+    };
+   return(NULL);
+ }
+
+void reassemble_text(fatlength,fatptr2,btptr2,dirptr2)
+ int fatlength;
+ fatentry_tp * fatptr2;
+ bootsec_tp *btptr2;
+ struct direntry_tp *dirptr2;
+ { unsigned int *orphan,*succ,*pred,*group,*efrom,*eto,*estart,*eorder;
+   int *escore;
+   unsigned int n,nedges,i,j,k,q,a,b,m,files,number,eof,csize;
+   int score,maxscore,c,all;
+   long length;
+   char name[NLENGTH + 1];
+   if ((textinfo == NULL) && (build_suggestindex(btptr2) != 0))
+    { errormessage(FATALERR,NOMEM);
+      return;
+    };
+   /* the free text clusters */
+   for (i = 0,n = 0;i < ntext;i++)
+    { if (get_fat_value(textinfo[i].cluster,fatlength,WORKFAT,fatptr2) == NOFAT)
+       { n++; };
+    };
+   if (n == 0)
+    { errormessage(BOOTERR,NOORPHANERR);
+      return;
+    };
+   orphan = calloc(n,sizeof(unsigned int));
+   succ = calloc(n,sizeof(unsigned int));
+   pred = calloc(n,sizeof(unsigned int));
+   group = calloc(n,sizeof(unsigned int));
+   efrom = calloc(n * REASSEMBLEK,sizeof(unsigned int));
+   eto = calloc(n * REASSEMBLEK,sizeof(unsigned int));
+   escore = calloc(n * REASSEMBLEK,sizeof(int));
+   if ((orphan == NULL) || (succ == NULL) || (pred == NULL) || (group == NULL) ||
+       (efrom == NULL) || (eto == NULL) || (escore == NULL))
+    { errormessage(FATALERR,NOMEM);
+      free(orphan); free(succ); free(pred); free(group);
+      free(efrom); free(eto); free(escore);
+      return;
+    };
+   for (i = 0,j = 0;i < ntext;i++)
+    { if (get_fat_value(textinfo[i].cluster,fatlength,WORKFAT,fatptr2) == NOFAT)
+       { orphan[j] = i; succ[j] = n; pred[j] = n; group[j] = j;
+         j++;
+       };
+    };
+   /* the REASSEMBLEK best edges of each orphaned cluster, to orphaned ones */
+   nedges = 0; maxscore = 0;
+   for (a = 0;a < n;a++)
+    { if (!textinfo[orphan[a]].full)
+       { continue;
+       };
+      m = 0;
+      for (b = 0;b < n;b++)
+       { if (b == a)
+          { continue;
+          };
+         score = text_score(&textinfo[orphan[a]],&textinfo[orphan[b]]);
+         if (score <= 0)
+          { continue;
+          };
+         /* insert into the sorted edges of "a", with the same score,
+            the nearest cluster after "a" comes first */
+         for (k = m;(k > 0) && ((escore[nedges + k - 1] < score) ||
+              ((escore[nedges + k - 1] == score) &&
+               (cluster_distance(orphan[a],orphan[b]) <
+                cluster_distance(orphan[a],orphan[eto[nedges + k - 1]]))));k--)
+          { if (k < REASSEMBLEK)
+             { eto[nedges + k] = eto[nedges + k - 1];
+               escore[nedges + k] = escore[nedges + k - 1];
+             };
+          };
+         if (k < REASSEMBLEK)
+          { eto[nedges + k] = b;
+            escore[nedges + k] = score;
+            if (m < REASSEMBLEK) { m++; };
+          };
+       };
+      for (k = 0;k < m;k++)
+       { efrom[nedges + k] = a;
+         if (escore[nedges + k] > maxscore) { maxscore = escore[nedges + k]; };
+       };
+      nedges += m;
+    };
+   /* the edges sorted by the score once, the best first, the same
+      score in the order of the edges ( counting sort ) */
+   estart = calloc((unsigned int)maxscore + 2,sizeof(unsigned int));
+   eorder = calloc(nedges + 1,sizeof(unsigned int));
+   if ((estart == NULL) || (eorder == NULL))
+    { errormessage(FATALERR,NOMEM);
+      free(estart); free(eorder);
+      free(orphan); free(succ); free(pred); free(group);
+      free(efrom); free(eto); free(escore);
+      return;
+    };
+   for (k = 0;k < nedges;k++)
+    { estart[maxscore - escore[k] + 1]++;
+    };
+   for (score = 0;score <= maxscore;score++)
+    { estart[score + 1] += estart[score];
+    };
+   for (k = 0;k < nedges;k++)
+    { eorder[estart[maxscore - escore[k]]++] = k;
+    };
+   free(estart);
+   /* path cover : each cluster has one successor and one predecessor
+      at most, without a loop */
+   for (q = 0;q < nedges;q++)
+    { k = eorder[q];
+      a = efrom[k]; b = eto[k];
+      if ((succ[a] != n) || (pred[b] != n))
+       { continue;
+       };
+      /* the roots of the groups, halving the paths */
+      for (i = a;group[i] != i;i = group[i])
+       { group[i] = group[group[i]];
+       };
+      for (j = b;group[j] != j;j = group[j])
+       { group[j] = group[group[j]];
+       };
+      if (i == j)
+       { continue;
+       };
+      succ[a] = b; pred[b] = a;
+      group[j] = i;
+    };
+   free(eorder);
+   free(efrom); free(eto); free(escore); free(group);
+   /* the proposed files */
+   eof = (fattyp == FAT12B) ? (RESCLUST12 | 0x0F) :
+         ((fattyp == FAT32B) ? (unsigned int)(RESCLUST32 | 0x0F) : (RESCLUST | 0x0F));
+   csize = secsize * (*btptr2).sectors_per_cluster;
+   printf("%u orphaned text clusters\n",n);
+   files = 0; number = 0; all = 0;
+   for (a = 0;a < n;a++)
+    { if (pred[a] != n)
+       { continue;
+       };
+      k = a;
+      for (b = a,m = 0;b != n;b = succ[b],m++)
+       { if (m < 8)
+          { printf("%s$(%x)",(m > 0) ? "->" : "",textinfo[orphan[b]].cluster); };
+         k = b;
+       };
+      length = (long)(m - 1) * csize + textinfo[orphan[k]].length;
+      printf("%s : %u clusters, filelength $(%lx)\n",(m > 8) ? "->..." : "",m,length);
+      c = 'Y';
+      if (!all)
+       { printf("Do You want to save it as text file ? Y/N/A(ll)/Q(uit) ");
+         c = toupper(getch());
+         printf("\n");
+       };
+      if (c == 'Q')
+       { break;
+       };
+      if (c == 'A')
+       { all = !0; c = 'Y';
+       };
+      if (c != 'Y')
+       { continue;
+       };
+      /* the next name, which is not yet used */
+      for (;number <= 9999;number++)
+       { sprintf(name,"TEXT%04u",number);
+         if (!chk_exists(name,"TXT",dirptr2,DIRENTRIES(btptr2)))
+          { break;
+          };
+       };
+      if (number > 9999)
+       { errormessage(BOOTERR,NONAMEERR);
+         break;
+       };
+      number++;
+      if (make_direntry(name,"TXT",textinfo[orphan[a]].cluster,length,
+                        btptr2,dirptr2) == NULL)
+       { errormessage(BOOTERR,ROOTFULLERR);
+         break;
+       };
+      for (b = a;succ[b] != n;b = succ[b])
+       { set_fat_value(textinfo[orphan[succ[b]]].cluster,textinfo[orphan[b]].cluster,
+                       fatlength,WORKFAT,fatptr2);
+       };
+      set_fat_value(eof,textinfo[orphan[b]].cluster,fatlength,WORKFAT,fatptr2);
+      files++;
+    };
+   printf("%u text files saved\n",files);
+   free(orphan); free(succ); free(pred);
+ }
+
+/******************/
+/* content search */
+/******************/
+
+int parse_pattern(text,pattern)
+ char *text;
+ unsigned char *pattern;
+ { int n,len;
+   unsigned int x;
+   len = 0;
+   if (text[0] != '$')
+    { /* a literal text */
+      for (;(*text != '\0') && (len < SEARCHMAX);text++)
+       { pattern[len++] = (unsigned char)*text;
+       };
+      return(len);
+    };
+   /* $ and hex bytes, like "$4D 5A" */
+   for (text++;*text != '\0';)
+    { if (*text == ' ')
+       { text++;
+         continue;
+       };
+      if ((len >= SEARCHMAX) || (sscanf(text,"%2x%n",&x,&n) != 1))
+       { return(-1);
+       };
+      pattern[len++] = (unsigned char)x;
+      text += n;
+    };
+   return(len);
+ }
+
+unsigned long search_clusters(pattern,len,hitcl,hitoff,maxhits,btptr2)
+ unsigned char *pattern;
+ int len;
+ unsigned int *hitcl,*hitoff;
+ unsigned int maxhits;
+ bootsec_tp *btptr2;
+ { unsigned char *buffer,*data,*p,*end;
+   unsigned char seam[2 * SEARCHMAX];
+   unsigned int cl,n,csize,chunk,carry,i;
+   unsigned long nhits,pos;
+   csize = secsize * (*btptr2).sectors_per_cluster;
+   /* large sequential reads of whole runs of clusters */
+   chunk = (csize < SEARCHBUFSIZE) ? SEARCHBUFSIZE / csize : 1;
+   if ((buffer = malloc(chunk * csize)) == NULL)
+    { errormessage(FATALERR,NOMEM);
+      return(0);
+    };
+   nhits = 0; carry = 0;
+   for (cl = 2;cl < (unsigned int)clusters;cl += n)
+    { n = ((unsigned int)clusters - cl < chunk) ? (unsigned int)clusters - cl : chunk;
+      if ((data = get_clusters(cl,n,buffer,btptr2)) == NULL)
+       { carry = 0;
+         continue;
+       };
+      /* a match across the end of the last read */
+      if (carry > 0)
+       { memcpy(seam + carry,data,len - 1);
+         for (i = 0;i < carry;i++)
+          { if (memcmp(seam + i,pattern,len) == 0)
+             { pos = (unsigned long)(cl - 2) * csize - carry + i;
+               if (nhits < maxhits)
+                { hitcl[nhits] = (unsigned int)(pos / csize) + 2;
+                  hitoff[nhits] = (unsigned int)(pos % csize);
+                };
+               nhits++;
+             };
+          };
+       };
+      /* memchr finds the first byte, memcmp verifies the rest */
+      end = data + (unsigned long)n * csize;
+      for (p = data;(p = memchr(p,pattern[0],(size_t)(end - p - len + 1))) != NULL;p++)
+       { if (memcmp(p,pattern,len) == 0)
+          { if (nhits < maxhits)
+             { hitcl[nhits] = cl + (unsigned int)((p - data) / csize);
+               hitoff[nhits] = (unsigned int)((p - data) % csize);
+             };
+            nhits++;
+          };
+         if (end - p <= len)
+          { break;
+          };
+       };
+      carry = len - 1;
+      memcpy(seam,end - carry,carry);
+    };
+   free(buffer);
+   return(nhits);
+ }
+
+unsigned int search_content(selfentry,fatlength,fatptr2,btptr2)
+ unsigned int selfentry;
+ int fatlength;
+ fatentry_tp * fatptr2;
+ bootsec_tp *btptr2;
+ { char text[IMGNAMELEN];
+   unsigned char pattern[SEARCHMAX];
+   unsigned int hitcl[SEARCHHITS],hitoff[SEARCHHITS];
+   unsigned long nhits,k;
+   int len,choice;
+   text[0] = '\0';
+   printf("? search for ( text, or $ and hex bytes ) : ");
+   scanf(" %79[^\n]%*c",text);
+   if ((len = parse_pattern(text,pattern)) <= 0)
+    { errormessage(BOOTERR,PATTERNERR);
+      return(selfentry);
+    };
+   if ((nhits = search_clusters(pattern,len,hitcl,hitoff,SEARCHHITS,btptr2)) == 0)
+    { errormessage(BOOTERR,NOTFOUNDERR);
+      return(selfentry);
+    };
+   for (k = 0;(k < nhits) && (k < SEARCHHITS);k++)
+    { printf("%2lu = $(%5x) offset $(%4x) %s\n",k + 1,hitcl[k],hitoff[k],
+             (get_fat_value(hitcl[k],fatlength,WORKFAT,fatptr2) == NOFAT) ? "free" : "used");
+    };
+   printf("%lu hits",nhits);
+   if (nhits > SEARCHHITS)
+    { printf(", the first %u are shown",SEARCHHITS);
+    };
+   printf("\n");
+   choice = 0;
+   printf("? goto hit number ( 0 = none ) : ");
+   scanf("%d%*c",&choice);
+   if ((choice < 1) || ((unsigned long)choice > nhits) || (choice > SEARCHHITS))
+    { return(selfentry);
+    };
+   return(hitcl[choice - 1]);
+ }
+
+unsigned int ac_insert(ac,pattern,len,index)
+ struct acauto_tp *ac;
+ unsigned char *pattern;
+ int len,index;
+ { unsigned int state,next;
+   int i;
+   state = 0;
+   for (i = 0;i < len;i++)
+    { for (next = (*ac).node[state].child;
+           (next != 0) && ((*ac).node[next].byte != pattern[i]);
+           next = (*ac).node[next].sibling)
+       { };
+      if (next == 0)
+       { if ((*ac).nnodes >= ACNODES)
+          { return(0);
+          };
+         next = (*ac).nnodes++;
+         (*ac).node[next].byte = pattern[i];
+         (*ac).node[next].pattern = -1;
+         (*ac).node[next].sibling = (*ac).node[state].child;
+         (*ac).node[state].child = next;
+       };
+      state = next;
+    };
+   (*ac).node[state].pattern = index;
+   return(state);
+ }
+
+unsigned int ac_step(ac,state,c)
+ struct acauto_tp *ac;
+ unsigned int state;
+ unsigned char c;
+ { unsigned int next;
+   for (;;)
+    { if (state == 0)
+       { /* the root has a full table */
+         return((*ac).root[c]);
+       };
+      for (next = (*ac).node[state].child;
+           (next != 0) && ((*ac).node[next].byte != c);
+           next = (*ac).node[next].sibling)
+       { };
+      if (next != 0)
+       { return(next);
+       };
+      state = (*ac).node[state].fail;
+    };
+ }
+
+int ac_build(ac)
+ struct acauto_tp *ac;
+ { unsigned int *queue,head,tail,state,next,f;
+   if ((queue = malloc((*ac).nnodes * sizeof(unsigned int))) == NULL)
+    { return(!0);
+    };
+   head = 0; tail = 0;
+   memset((*ac).root,0,sizeof((*ac).root));
+   for (next = (*ac).node[0].child;next != 0;next = (*ac).node[next].sibling)
+    { (*ac).root[(*ac).node[next].byte] = next;
+      (*ac).node[next].fail = 0;
+      (*ac).node[next].dict = 0;
+      queue[tail++] = next;
+    };
+   /* breadth first : the failure link of a node is found by the one
+      of its parent, "dict" is the next node with a pattern on that way */
+   while (head < tail)
+    { state = queue[head++];
+      for (next = (*ac).node[state].child;next != 0;next = (*ac).node[next].sibling)
+       { f = ac_step(ac,(*ac).node[state].fail,(*ac).node[next].byte);
+         (*ac).node[next].fail = f;
+         (*ac).node[next].dict = ((*ac).node[f].pattern >= 0) ? f : (*ac).node[f].dict;
+         queue[tail++] = next;
+       };
+    };
+   free(queue);
+   return(0);
+ }
+
+int ac_load(filename,ac)
+ char *filename;
+ struct acauto_tp *ac;
+ { FILE *fp;
+   char line[LINELEN];
+   unsigned char pattern[SEARCHMAX];
+   int len;
+   char *p;
+   if ((fp = fopen(filename,"r")) == NULL)
+    { errormessage(BOOTERR,PATFILEERR);
+      return(-1);
+    };
+   (*ac).nnodes = 1;
+   (*ac).npatterns = 0;
+   (*ac).node[0].pattern = -1;
+   while (fgets(line,LINELEN,fp) != NULL)
+    { for (p = line + strlen(line);(p > line) && ((p[-1] == '\n') || (p[-1] == '\r'));p--)
+       { };
+      *p = '\0';
+      /* empty lines and comments */
+      if ((line[0] == '\0') || (line[0] == ';'))
+       { continue;
+       };
+      if (((*ac).npatterns >= ACPATTERNS) ||
+          ((len = parse_pattern(line,pattern)) <= 0) ||
+          (ac_insert(ac,pattern,len,(*ac).npatterns) == 0))
+       { printf("%s\n",line);
+         errormessage(BOOTERR,PATCOUNTERR);
+         fclose(fp);
+         return(-1);
+       };
+      strcpy((*ac).name[(*ac).npatterns++],line);
+    };
+   fclose(fp);
+   if (ac_build(ac) != 0)
+    { errormessage(FATALERR,NOMEM);
+      return(-1);
+    };
+   return((*ac).npatterns);
+ }
+
+void scan_patterns(btptr2)
+ bootsec_tp *btptr2;
+ { char filename[IMGNAMELEN];
+   struct acauto_tp *ac;
+   unsigned char *buffer,*data,*p,*end;
+   unsigned int cl,n,k,csize,chunk,state,d,rows;
+   unsigned int count[ACPATTERNS];
+   unsigned long total[ACPATTERNS];
+   int i,hit;
+   FILE *out;
+   printf("? pattern file : ");
+   scanf(" %79s%*c",filename);
+   if ((ac = calloc(1,sizeof(struct acauto_tp))) == NULL)
+    { errormessage(FATALERR,NOMEM);
+      return;
+    };
+   if (((*ac).node = calloc(ACNODES,sizeof(struct acnode_tp))) == NULL)
+    { errormessage(FATALERR,NOMEM);
+      free(ac);
+      return;
+    };
+   if (ac_load(filename,ac) <= 0)
+    { free((*ac).node); free(ac);
+      return;
+    };
+   printf("? hit matrix file ( - = screen ) : ");
+   scanf(" %79s%*c",filename);
+   out = stdout;
+   if ((strcmp(filename,"-") != 0) && ((out = fopen(filename,"w")) == NULL))
+    { errormessage(BOOTERR,PATFILEERR);
+      free((*ac).node); free(ac);
+      return;
+    };
+   csize = secsize * (*btptr2).sectors_per_cluster;
+   chunk = (csize < SEARCHBUFSIZE) ? SEARCHBUFSIZE / csize : 1;
+   if ((buffer = malloc(chunk * csize)) == NULL)
+    { errormessage(FATALERR,NOMEM);
+      if (out != stdout) { fclose(out); };
+      free((*ac).node); free(ac);
+      return;
+    };
+   for (i = 0;i < (*ac).npatterns;i++)
+    { fprintf(out,"pattern %2d : %s\n",i + 1,(*ac).name[i]);
+      total[i] = 0;
+    };
+   /* one pass over all clusters, each cluster is searched on its own */
+   rows = 0;
+   for (cl = 2;cl < (unsigned int)clusters;cl += n)
+    { n = ((unsigned int)clusters - cl < chunk) ? (unsigned int)clusters - cl : chunk;
+      if ((data = get_clusters(cl,n,buffer,btptr2)) == NULL)
+       { continue;
+       };
+      for (k = 0;k < n;k++)
+       { memset(count,0,sizeof(count));
+         hit = 0;
+         state = 0;
+         end = data + (unsigned long)(k + 1) * csize;
+         for (p = data + (unsigned long)k * csize;p < end;p++)
+          { state = ac_step(ac,state,*p);
+            for (d = ((*ac).node[state].pattern >= 0) ? state : (*ac).node[state].dict;
+                 d != 0;d = (*ac).node[d].dict)
+             { count[(*ac).node[d].pattern]++;
+               hit = !0;
+             };
+          };
+         if (!hit)
+          { continue;
+          };
+         /* a row of the matrix : . = no hit, 1..9 hits, * = more */
+         fprintf(out,"$(%5x) : ",cl + k);
+         for (i = 0;i < (*ac).npatterns;i++)
+          { fputc((count[i] == 0) ? '.' : ((count[i] < 10) ? '0' + count[i] : '*'),out);
+            total[i] += count[i];
+          };
+         fputc('\n',out);
+         rows++;
+       };
+    };
+   for (i = 0;i < (*ac).npatterns;i++)
+    { printf("pattern %2d : %lu hits\n",i + 1,total[i]);
+    };
+   printf("%u clusters with hits\n",rows);
+   if (out != stdout)
+    { fclose(out);
+    };
+   free(buffer);
+   free((*ac).node); free(ac);
+ }
+
+/***********/
+/* carving */
+/***********/
+
+int carve_byte(r,offset)
+ struct carveread_tp *r;
+ unsigned long offset;
+ { unsigned int cl;
+   /* the file is assumed to be contiguous */
+   if (offset / (*r).csize >= CARVEMAX)
+    { return(-1);
+    };
+   cl = (*r).first + (unsigned int)(offset / (*r).csize);
+   if (cl >= (unsigned int)clusters)
+    { return(-1);
+    };
+   if ((cl != (*r).cl) || ((*r).data == NULL))
+    { (*r).cl = cl;
+      if (((*r).data = get_clusters(cl,1,(*r).buffer,(*r).bt)) == NULL)
+       { return(-1);
+       };
+    };
+   return((int)(*r).data[(unsigned int)(offset % (*r).csize)]);
+ }
+
+long carve_le(r,offset,n)
+ struct carveread_tp *r;
+ unsigned long offset;
+ int n;
+ { long value;
+   int c;
+   value = 0;
+   for (n--;n >= 0;n--)
+    { if ((c = carve_byte(r,offset + n)) < 0)
+       { return(-1);
+       };
+      value = (value << 8) | c;
+    };
+   return(value);
+ }
+
+long carve_find(r,offset,footer,len)
+ struct carveread_tp *r;
+ unsigned long offset;
+ unsigned char *footer;
+ int len;
+ { int c,i;
+   for (;(c = carve_byte(r,offset)) >= 0;offset++)
+    { if (c != footer[0])
+       { continue;
+       };
+      for (i = 1;(i < len) && (carve_byte(r,offset + i) == footer[i]);i++)
+       { };
+      if (i == len)
+       { return((long)offset);
+       };
+    };
+   return(-1);
+ }
+
+long carve_extent(kind,r)
+ int kind;
+ struct carveread_tp *r;
+ { static unsigned char zipend[4] = { 'P', 'K', 0x05, 0x06 };
+   static unsigned char jpegend[2] = { 0xFF, 0xD9 };
+   long a,b,pos;
+   int c,i;
+   switch (kind)
+    { case CVEXE :
+       { /* bytes of the last page, number of pages of 512 bytes */
+         a = carve_le(r,2L,2); b = carve_le(r,4L,2);
+         if ((a < 0) || (a >= 512) || (b <= 0))
+          { return(-1);
+          };
+         return(b * 512 - ((a > 0) ? 512 - a : 0));
+       };
+      case CVBMP :
+       { a = carve_le(r,2L,4); b = carve_le(r,6L,4);
+         if ((a < 26) || (b != 0) || (a > (long)CARVEMAX * (*r).csize))
+          { return(-1);
+          };
+         return(a);
+       };
+      case CVZIP :
+       { /* end of the central directory, with the length of the comment */
+         if ((pos = carve_find(r,4L,zipend,4)) < 0)
+          { return(0);
+          };
+         return(((a = carve_le(r,pos + 20,2)) < 0) ? 0 : pos + 22 + a);
+       };
+      case CVJPEG :
+       { return(((pos = carve_find(r,3L,jpegend,2)) < 0) ? 0 : pos + 2);
+       };
+      case CVARC :
+       { /* the first header : method, name of 13 bytes */
+         c = carve_byte(r,1L);
+         if ((c < 1) || (c > 9))
+          { return(-1);
+          };
+         for (i = 0;(i < 13) && ((c = carve_byte(r,2L + i)) > 0x20) && (c < 0x7F);i++)
+          { };
+         if ((i == 0) || (i == 13) || (c != 0))
+          { return(-1);
+          };
+         /* from header to header, up to the end marker 1A 00 */
+         for (pos = 0;;)
+          { if (carve_byte(r,pos) != 0x1A)
+             { return(0);
+             };
+            if ((c = carve_byte(r,pos + 1)) <= 0)
+             { return((c == 0) ? pos + 2 : 0);
+             };
+            if ((a = carve_le(r,pos + 15,4)) < 0)
+             { return(0);
+             };
+            pos += ((c == 1) ? 25 : 29) + a;
+          };
+       };
+      case CVGIF :
+       { /* screen descriptor and global color table */
+         if (((c = carve_byte(r,4L)) != '7') && (c != '9'))
+          { return(-1);
+          };
+         c = carve_byte(r,10L);
+         pos = 13 + ((c & 0x80) ? 3L << ((c & 0x07) + 1) : 0);
+         for (;;)
+          { switch (carve_byte(r,pos))
+             { case 0x3B : { return(pos + 1);};
+               case 0x21 : { pos += 2; break;};
+               case 0x2C :
+                { c = carve_byte(r,pos + 9);
+                  pos += 10 + ((c & 0x80) ? 3L << ((c & 0x07) + 1) : 0) + 1;
+                  break;};
+               default   : { return(0);};
+             };
+            /* data sub-blocks up to the empty one */
+            while ((c = carve_byte(r,pos)) > 0)
+             { pos += c + 1;
+             };
+            if (c < 0)
+             { return(0);
+             };
+            pos++;
+          };
+       };
+      default : { break;};
+    };
+   return(0);
+ }
+
+unsigned int carve_files(cand,maxcand,btptr2)
+ struct carvecand_tp *cand;
+ unsigned int maxcand;
+ bootsec_tp *btptr2;
+ { struct carveread_tp r;
+   unsigned char *buffer,*data,*p;
+   unsigned int cl,n,k,csize,chunk,ncand;
+   int i;
+   long length;
+   csize = secsize * (*btptr2).sectors_per_cluster;
+   chunk = (csize < SEARCHBUFSIZE) ? SEARCHBUFSIZE / csize : 1;
+   buffer = malloc(chunk * csize);
+   r.buffer = malloc(csize);
+   if ((buffer == NULL) || (r.buffer == NULL))
+    { errormessage(FATALERR,NOMEM);
+      free(buffer); free(r.buffer);
+      return(0);
+    };
+   r.csize = csize; r.bt = btptr2;
+   ncand = 0;
+   /* a file starts at the start of a cluster */
+   for (cl = 2;(cl < (unsigned int)clusters) && (ncand < maxcand);cl += n)
+    { n = ((unsigned int)clusters - cl < chunk) ? (unsigned int)clusters - cl : chunk;
+      if ((data = get_clusters(cl,n,buffer,btptr2)) == NULL)
+       { continue;
+       };
+      for (k = 0;(k < n) && (ncand < maxcand);k++)
+       { p = data + (unsigned long)k * csize;
+         for (i = 0;i < CARVESIGS;i++)
+          { if (memcmp(p,carvesigs[i].magic,carvesigs[i].len) != 0)
+             { continue;
+             };
+            r.first = cl + k; r.cl = 0; r.data = NULL;
+            if ((length = carve_extent(carvesigs[i].kind,&r)) < 0)
+             { continue;
+             };
+            cand[ncand].cluster = cl + k;
+            cand[ncand].sig = i;
+            cand[ncand].length = length;
+            ncand++;
+            break;
+          };
+       };
+    };
+   if ((ncand == maxcand) && (cand[ncand - 1].cluster + 1 < (unsigned int)clusters))
+    { printf("the list is truncated after %u files, at cluster $(%x)\n",
+             ncand,cand[ncand - 1].cluster);
+    };
+   free(buffer); free(r.buffer);
+   return(ncand);
+ }
+
+void carve_menu(fatlength,fatptr2,btptr2,dirptr2)
+ int fatlength;
+ fatentry_tp * fatptr2;
+ bootsec_tp *btptr2;
+ struct direntry_tp *dirptr2;
+ { struct carvecand_tp *cand;
+   struct direntry_tp *dp;
+   unsigned int ncand,k,i,n,used,csize,eof,cl,number;
+   int choice,c;
+   char name[NLENGTH + 1];
+   if ((cand = calloc(CARVEHITS,sizeof(struct carvecand_tp))) == NULL)
+    { errormessage(FATALERR,NOMEM);
+      return;
+    };
+   ncand = carve_files(cand,CARVEHITS,btptr2);
+   csize = secsize * (*btptr2).sectors_per_cluster;
+   for (k = 0;k < ncand;k++)
+    { printf("%3u = $(%5x) %-4s ",k + 1,cand[k].cluster,carvesigs[cand[k].sig].name);
+      if (cand[k].length == 0)
+       { printf("filelength unknown\n");
+         continue;
+       };
+      n = (unsigned int)((cand[k].length + csize - 1) / csize);
+      for (i = 0,used = 0;(i < n) && (cand[k].cluster + i < (unsigned int)clusters);i++)
+       { if (get_fat_value(cand[k].cluster + i,fatlength,WORKFAT,fatptr2) != NOFAT)
+          { used++; };
+       };
+      printf("filelength $(%8lx) %5u clusters, %u of them are not free\n",
+             cand[k].length,n,used);
+    };
+   printf("%u files found\n",ncand);
+   choice = 0;
+   printf("? link file number ( 0 = none ) : ");
+   scanf("%d%*c",&choice);
+   if ((choice < 1) || ((unsigned int)choice > ncand))
+    { free(cand);
+      return;
+    };
+   k = choice - 1;
+   n = (unsigned int)((cand[k].length + csize - 1) / csize);
+   if ((cand[k].length == 0) || (cand[k].cluster + n > (unsigned int)clusters))
+    { errormessage(BOOTERR,CARVEERR);
+      free(cand);
+      return;
+    };
+   /* clusters of other files are just taken over on request */
+   for (i = 0,used = 0;i < n;i++)
+    { if (get_fat_value(cand[k].cluster + i,fatlength,WORKFAT,fatptr2) != NOFAT)
+       { used++; };
+    };
+   if (used > 0)
+    { printf("%u clusters are not free, their FAT entries are overwritten.\n",used);
+      printf("Do You really want to link them ? Y/N ");
+      c = getch();
+      printf("\n");
+      if (toupper(c) != 'Y')
+       { free(cand);
+         return;
+       };
+    };
+   printf("Do You want a new direntry for the file ? Y/N ");
+   c = getch();
+   printf("\n");
+   if (toupper(c) == 'Y')
+    { /* the next name, which is not yet used */
+      for (number = 0;number <= 9999;number++)
+       { sprintf(name,"CARV%04u",number);
+         if (!chk_exists(name,carvesigs[cand[k].sig].ext,dirptr2,DIRENTRIES(btptr2)))
+          { break;
+          };
+       };
+      if (number > 9999)
+       { errormessage(BOOTERR,NONAMEERR);
+         free(cand);
+         return;
+       };
+      dp = make_direntry(name,carvesigs[cand[k].sig].ext,cand[k].cluster,
+                         cand[k].length,btptr2,dirptr2);
+      if (dp == NULL)
+       { errormessage(BOOTERR,ROOTFULLERR);
+         free(cand);
+         return;
+       };
+    }
+   else
+    { dp = dirptr2 + ask_dentry(dir_entry,btptr2);
+      if (((* dp).filename[0] != 0x00) && ((* dp).filename[0] != 0xE5))
+       { printf("->$(%4x):",(unsigned int)(dp - dirptr2));
+         display_direntry(!0,dp);
+         printf("Do You really want to overwrite this direntry ? Y/N ");
+         c = getch();
+         printf("\n");
+         if (toupper(c) != 'Y')
+          { free(cand);
+            return;
+          };
+       };
+      (* dp).startcluster = (word_tp)(cand[k].cluster & 0xFFFF);
+      if (fattyp == FAT32B)
+       { (* dp).startcluster_high = (word_tp)((unsigned long)cand[k].cluster >> 16);
+       };
+      (* dp).filelength = cand[k].length;
+      mark_direntry(dp);
+    };
+   /* the carved file is contiguous */
+   eof = (fattyp == FAT12B) ? (RESCLUST12 | 0x0F) :
+         ((fattyp == FAT32B) ? (unsigned int)(RESCLUST32 | 0x0F) : (RESCLUST | 0x0F));
+   for (cl = cand[k].cluster;cl < cand[k].cluster + n - 1;cl++)
+    { set_fat_value(cl + 1,cl,fatlength,WORKFAT,fatptr2);
+    };
+   set_fat_value(eof,cl,fatlength,WORKFAT,fatptr2);
+   free(cand);
+ }
+
+/**************/
+/* hash index */
+/**************/
+
+unsigned long hash_cluster(data,nbytes)
+ unsigned char *data;
+ unsigned int nbytes;
+ { unsigned long h;
+   unsigned int i;
+   /* FNV-1a, 32 bits */
+   h = 2166136261UL;
+   for (i = 0;i < nbytes;i++)
+    { h = ((h ^ data[i]) * 16777619UL) & 0xFFFFFFFFUL;
+    };
+   return(h);
+ }
+
+void put_le(fp,value,n)
+ FILE *fp;
+ unsigned long value;
+ int n;
+ { for (;n > 0;n--,value >>= 8)
+    { fputc((int)(value & 0xFF),fp);
+    };
+ }
+
+unsigned long get_le(fp,n)
+ FILE *fp;
+ int n;
+ { unsigned long value;
+   int i,c;
+   value = 0;
+   for (i = 0;i < n;i++)
+    { if ((c = fgetc(fp)) == EOF)
+       { c = 0;
+       };
+      value |= (unsigned long)c << (8 * i);
+    };
+   return(value);
+ }
+
+int write_hashindex(filename,fatlength,fatptr2,btptr2,dirptr2)
+ char *filename;
+ int fatlength;
+ fatentry_tp * fatptr2;
+ bootsec_tp *btptr2;
+ struct direntry_tp *dirptr2;
+ { FILE *fp;
+   unsigned char *buffer,*data;
+   unsigned int cl,n,k,csize,chunk;
+   int d,nentries;
+   if ((fp = fopen(filename,"wb")) == NULL)
+    { errormessage(BOOTERR,HASHFILEERR);
+      return(!0);
+    };
+   csize = secsize * (*btptr2).sectors_per_cluster;
+   chunk = (csize < SEARCHBUFSIZE) ? SEARCHBUFSIZE / csize : 1;
+   if ((buffer = malloc(chunk * csize)) == NULL)
+    { errormessage(FATALERR,NOMEM);
+      fclose(fp);
+      return(!0);
+    };
+   for (d = 0,nentries = 0;d < DIRENTRIES(btptr2);d++)
+    { if (DIRFILE(dirptr2 + d)) { nentries++; };
+    };
+   fwrite(HASHMAGIC,1,4,fp);
+   put_le(fp,(unsigned long)csize,4);
+   put_le(fp,(unsigned long)clusters,4);
+   put_le(fp,(unsigned long)nentries,4);
+   /* hash and FAT entry of each cluster */
+   for (cl = 2;cl < (unsigned int)clusters;cl += n)
+    { n = ((unsigned int)clusters - cl < chunk) ? (unsigned int)clusters - cl : chunk;
+      data = get_clusters(cl,n,buffer,btptr2);
+      for (k = 0;k < n;k++)
+       { put_le(fp,(data == NULL) ? 0UL :
+                hash_cluster(data + (unsigned long)k * csize,csize),4);
+         put_le(fp,(unsigned long)get_fat_value(cl + k,fatlength,WORKFAT,fatptr2),4);
+       };
+    };
+   /* the files of the main directory */
+   for (d = 0;d < DIRENTRIES(btptr2);d++)
+    { if (DIRFILE(dirptr2 + d))
+       { fwrite(dirptr2 + d,sizeof(struct direntry_tp),1,fp);
+       };
+    };
+   free(buffer);
+   if (ferror(fp) | fclose(fp))
+    { errormessage(BOOTERR,HASHFILEERR);
+      return(!0);
+    };
+   printf("%u clusters, %d files of the main directory\n",clusters - 2,nentries);
+   return(0);
+ }
+
+void match_hashindex(filename,fatlength,fatptr2,btptr2,dirptr2)
+ char *filename;
+ int fatlength;
+ fatentry_tp * fatptr2;
+ bootsec_tp *btptr2;
+ struct direntry_tp *dirptr2;
+ { FILE *fp;
+   char magic[4];
+   unsigned char *buffer,*data,*dupmap,*seen;
+   unsigned long *refhash,*refnext,h;
+   unsigned int *table,*found,*chain;
+   unsigned int nref,nentries,tsize,cl,n,k,i,csize,chunk,slot,matched,eof;
+   unsigned int total,m,differ,v,used;
+   struct direntry_tp ref,*dp;
+   int e,d,c,all;
+   if ((fp = fopen(filename,"rb")) == NULL)
+    { errormessage(BOOTERR,HASHFILEERR);
+      return;
+    };
+   csize = secsize * (*btptr2).sectors_per_cluster;
+   if ((fread(magic,1,4,fp) != 4) || (memcmp(magic,HASHMAGIC,4) != 0))
+    { errormessage(BOOTERR,HASHFILEERR);
+      fclose(fp);
+      return;
+    };
+   if (get_le(fp,4) != (unsigned long)csize)
+    { errormessage(BOOTERR,HASHSIZEERR);
+      fclose(fp);
+      return;
+    };
+   nref = (unsigned int)get_le(fp,4);
+   nentries = (unsigned int)get_le(fp,4);
+   for (tsize = 1;tsize < 2 * nref;tsize <<= 1)
+    { };
+   chunk = (csize < SEARCHBUFSIZE) ? SEARCHBUFSIZE / csize : 1;
+   refhash = calloc(nref,sizeof(unsigned long));
+   refnext = calloc(nref,sizeof(unsigned long));
+   table = calloc(tsize,sizeof(unsigned int));
+   dupmap = calloc(BITMAPSIZE(nref) + 1,1);
+   seen = calloc(BITMAPSIZE(nref) + 1,1);
+   found = calloc(nref,sizeof(unsigned int));
+   chain = calloc(nref,sizeof(unsigned int));
+   buffer = malloc(chunk * csize);
+   if ((refhash == NULL) || (refnext == NULL) || (table == NULL) ||
+       (dupmap == NULL) || (seen == NULL) || (found == NULL) || (chain == NULL) ||
+       (buffer == NULL))
+    { errormessage(FATALERR,NOMEM);
+      fclose(fp);
+      free(refhash); free(refnext); free(table); free(dupmap); free(seen);
+      free(found); free(chain); free(buffer);
+      return;
+    };
+   /* hash table of the reference clusters, the ones with the same
+      contents ( like empty clusters ) are marked and not used */
+   for (cl = 2;cl < nref;cl++)
+    { refhash[cl] = get_le(fp,4);
+      refnext[cl] = get_le(fp,4);
+      for (slot = (unsigned int)refhash[cl] & (tsize - 1);
+           (table[slot] != 0) && (refhash[table[slot]] != refhash[cl]);
+           slot = (slot + 1) & (tsize - 1))
+       { };
+      if (table[slot] == 0)
+       { table[slot] = cl; }
+      else
+       { SETBIT(dupmap,table[slot]); };
+    };
+   /* each cluster of this disk, looked up in the hash table */
+   for (cl = 2;cl < (unsigned int)clusters;cl += n)
+    { n = ((unsigned int)clusters - cl < chunk) ? (unsigned int)clusters - cl : chunk;
+      if ((data = get_clusters(cl,n,buffer,btptr2)) == NULL)
+       { continue;
+       };
+      for (k = 0;k < n;k++)
+       { h = hash_cluster(data + (unsigned long)k * csize,csize);
+         for (slot = (unsigned int)h & (tsize - 1);
+              (table[slot] != 0) && (refhash[table[slot]] != h);
+              slot = (slot + 1) & (tsize - 1))
+          { };
+         if ((table[slot] != 0) && !TESTBIT(dupmap,table[slot]))
+          { if (found[table[slot]] == 0)
+             { found[table[slot]] = cl + k; }
+            else
+             { /* twice on this disk, the match is ambiguous */
+               SETBIT(dupmap,table[slot]);
+             };
+          };
+       };
+    };
+   for (cl = 2,matched = 0;cl < nref;cl++)
+    { if (TESTBIT(dupmap,cl))
+       { found[cl] = 0; }
+      else if (found[cl] != 0)
+       { matched++; };
+    };
+   free(buffer); free(table); free(dupmap);
+   printf("%u of %u clusters of the reference are found\n",matched,nref - 2);
+   /* the chains of the files of the reference, by the found clusters */
+   eof = (fattyp == FAT12B) ? (RESCLUST12 | 0x0F) :
+         ((fattyp == FAT32B) ? (unsigned int)(RESCLUST32 | 0x0F) : (RESCLUST | 0x0F));
+   all = 0;
+   for (e = 0;e < (int)nentries;e++)
+    { if (fread(&ref,sizeof(struct direntry_tp),1,fp) != 1)
+       { errormessage(BOOTERR,HASHFILEERR);
+         break;
+       };
+      total = 0; m = 0; differ = 0;
+      for (cl = STARTCLUSTER(&ref);(cl >= 2) && (cl < nref) && !TESTBIT(seen,cl);
+           cl = (unsigned int)refnext[cl])
+       { SETBIT(seen,cl);
+         chain[total++] = found[cl];
+         if (found[cl] != 0) { m++; };
+       };
+      /* a loop of the reference is cut */
+      for (cl = STARTCLUSTER(&ref);(cl >= 2) && (cl < nref) && TESTBIT(seen,cl);
+           cl = (unsigned int)refnext[cl])
+       { CLRBIT(seen,cl);
+       };
+      for (i = 0;(m == total) && (i < total);i++)
+       { v = get_fat_value(chain[i],fatlength,WORKFAT,fatptr2);
+         if ((i + 1 < total) ? (v != chain[i + 1]) : (v < (eof & ~0x0F)))
+          { differ++; };
+       };
+      printf("%-8.8s.%-3.3s : %u clusters, %u found",ref.filename,ref.extension,total,m);
+      if ((total == 0) || (m < total))
+       { printf("\n");
+         continue;
+       };
+      /* the direntry of the same name, or a new one */
+      for (d = 0,dp = NULL;(d < DIRENTRIES(btptr2)) && (dp == NULL);d++)
+       { if (memcmp((dirptr2 + d)->filename,ref.filename,NLENGTH + ELENGTH) == 0)
+          { dp = dirptr2 + d; };
+       };
+      if ((differ == 0) && (dp != NULL) && (STARTCLUSTER(dp) == chain[0]))
+       { printf(", linked\n");
+         continue;
+       };
+      /* the allocated clusters, which are not of the file itself */
+      for (i = 0,used = 0;i < total;i++)
+       { if ((get_fat_value(chain[i],fatlength,WORKFAT,fatptr2) != NOFAT) &&
+             ((ownerdir == NULL) || (dp == NULL) ||
+              (ownerdir[chain[i]] != (int)(dp - dirptr2))))
+          { used++; };
+       };
+      printf(", %u links differ, %u clusters are allocated\n",differ,used);
+      c = 'Y';
+      if (!all)
+       { printf("Do You want to link the file ? Y/N/A(ll)/Q(uit) ");
+         c = toupper(getch());
+         printf("\n");
+       };
+      if (c == 'Q')
+       { break;
+       };
+      if (c == 'A')
+       { all = !0; c = 'Y';
+       };
+      if ((c == 'Y') && (used > 0))
+       { /* always asked, the hash may match a cluster of another file */
+         printf("Do You really want to relink the %u allocated clusters ? Y/N ",used);
+         c = toupper(getch());
+         printf("\n");
+       };
+      if (c != 'Y')
+       { continue;
+       };
+      if ((dp == NULL) &&
+          ((dp = make_direntry("","",0,0L,btptr2,dirptr2)) == NULL))
+       { errormessage(BOOTERR,ROOTFULLERR);
+         break;
+       };
+      *dp = ref;
+      (* dp).startcluster = (word_tp)(chain[0] & 0xFFFF);
+      if (fattyp == FAT32B)
+       { (* dp).startcluster_high = (word_tp)((unsigned long)chain[0] >> 16);
+       };
+      mark_direntry(dp);
+      for (i = 0;i + 1 < total;i++)
+       { set_fat_value(chain[i + 1],chain[i],fatlength,WORKFAT,fatptr2);
+       };
+      set_fat_value(eof,chain[total - 1],fatlength,WORKFAT,fatptr2);
+    };
+   fclose(fp);
+   free(refhash); free(refnext); free(seen); free(found); free(chain);
+ }
+
+void hash_menu(fatlength,fatptr2,btptr2,dirptr2)
+ int fatlength;
+ fatentry_tp * fatptr2;
+ bootsec_tp *btptr2;
+ struct direntry_tp *dirptr2;
+ { char filename[IMGNAMELEN];
+   int c;
+   printf("W = write the hash index of this disk\n");
+   printf("M = match this disk with the hash index of a reference disk\n");
+   c = toupper(getch());
+   printf("? hash index file : ");
+   scanf(" %79s%*c",filename);
+   if (c == 'W')
+    { write_hashindex(filename,fatlength,fatptr2,btptr2,dirptr2);
+    }
+   else if (c == 'M')
+    { match_hashindex(filename,fatlength,fatptr2,btptr2,dirptr2);
+    };
+ }
+
+/*******************************/
+/* FAT rebuild from directory  */
+/*******************************/
+
+void rebuild_fat(fatlength,fatptr2,btptr2,dirptr2)
+ int fatlength;
+ fatentry_tp * fatptr2;
+ bootsec_tp *btptr2;
+ struct direntry_tp *dirptr2;
+ { unsigned int *newfat,*owner;
+   unsigned int cl,n,i,k,csize,eof,bad,files,used,overlaps,changed,kept,freed;
+   unsigned int e,entries;
+   unsigned int block[FATBLOCK];
+   unsigned char *reach;
+   int d,c,hadowner,nd;
+   struct direntry_tp *dp;
+   csize = secsize * (*btptr2).sectors_per_cluster;
+   /* the subdirectories are not contiguous files, their chains are kept */
+   if (refresh_dirtree(fatlength,fatptr2,btptr2) != 0)
+    { errormessage(BOOTERR,DIRTREEERR);
+      return;
+    };
+   newfat = calloc(clusters,sizeof(unsigned int));
+   owner = calloc(clusters,sizeof(unsigned int));
+   reach = calloc(BITMAPSIZE(clusters) + 1,1);
+   if ((newfat == NULL) || (owner == NULL) || (reach == NULL))
+    { errormessage(FATALERR,NOMEM);
+      free(newfat); free(owner); free(reach);
+      return;
+    };
+   eof = (fattyp == FAT12B) ? (RESCLUST12 | 0x0F) :
+         ((fattyp == FAT32B) ? (unsigned int)(RESCLUST32 | 0x0F) : (RESCLUST | 0x0F));
+   bad = (eof & ~0x0F) | 0x07;
+   files = 0; used = 0; overlaps = 0; kept = 0;
+   /* the bad clusters stay bad */
+   for (cl = 2;cl < (unsigned int)clusters;cl += n)
+    { n = (unsigned int)clusters - cl;
+      n = decode_fats(cl,(n < FATBLOCK) ? n : FATBLOCK,fatlength,WORKFAT,
+                      fatptr2,block);
+      if (n == 0)
+       { break;
+       };
+      for (k = 0;k < n;k++)
+       { if (block[k] == bad)
+          { owner[cl + k] = KEEPOWNER;
+            newfat[cl + k] = bad;
+          };
+       };
+    };
+   /* the chains of the subdirectories and of their files, as they are */
+   for (nd = 1;nd < ndirnodes;nd++)
+    { reach_chain(dirtree[nd].start,reach,fatlength,fatptr2);
+      dp = node_dir(nd);
+      entries = node_entries(nd);
+      for (e = 0;(e < entries) && (dp[e].filename[0] != 0x00);e++)
+       { if ((dp[e].filename[0] != 0xE5) && (dp[e].filename[0] != '.'))
+          { reach_chain(STARTCLUSTER(dp + e),reach,fatlength,fatptr2);
+          };
+       };
+    };
+   for (cl = 2;cl < (unsigned int)clusters;cl++)
+    { if (TESTBIT(reach,cl) && (owner[cl] == 0))
+       { owner[cl] = KEEPOWNER;
+         newfat[cl] = get_fat_value(cl,fatlength,WORKFAT,fatptr2);
+         kept++;
+       };
+    };
+   free(reach);
+   /* the main directory of FAT32 keeps its chain, as it is loaded */
+   if ((fattyp == FAT32B) && (rootclusters != NULL))
+    { n = dirsecs / (*btptr2).sectors_per_cluster;
+      for (i = 0;i < n;i++)
+       { cl = rootclusters[i];
+         if (ISCLUSTER(cl) && (owner[cl] == 0))
+          { owner[cl] = ROOTOWNER;
+            newfat[cl] = (i + 1 < n) ? rootclusters[i + 1] : eof;
+            used++;
+          };
+       };
+    };
+   /* the extent of each file, "owner" is the direntry + 1 */
+   for (d = 0;d < DIRENTRIES(btptr2);d++)
+    { dp = dirptr2 + d;
+      if (!DIRFILE(dp) || ((* dp).attribute & SUBDIR))
+       { continue;
+       };
+      files++;
+      cl = STARTCLUSTER(dp);
+      n = (unsigned int)(((* dp).filelength + csize - 1) / csize);
+      if (n == 0) { n = 1; };
+      if ((unsigned long)cl + n > (unsigned long)clusters)
+       { printf("%-8.8s.%-3.3s exceeds the data area\n",(* dp).filename,(* dp).extension);
+         n = (unsigned int)clusters - cl;
+       };
+      for (i = 0;(i < n) && (owner[cl + i] == 0);i++)
+       { owner[cl + i] = (unsigned int)d + 1;
+       };
+      if (i < n)
+       { /* the first file keeps the clusters, this one is cut */
+         overlaps++;
+         if (owner[cl + i] == ROOTOWNER)
+          { printf("%-8.8s.%-3.3s overlaps the main directory at $(%x)\n",
+                   (* dp).filename,(* dp).extension,cl + i);
+          }
+         else if (owner[cl + i] == KEEPOWNER)
+          { printf("%-8.8s.%-3.3s overlaps %s at $(%x)\n",
+                   (* dp).filename,(* dp).extension,
+                   (newfat[cl + i] == bad) ? "a bad cluster" : "a subdirectory",cl + i);
+          }
+         else
+          { k = owner[cl + i] - 1;
+            printf("%-8.8s.%-3.3s overlaps %-8.8s.%-3.3s at $(%x)\n",
+                   (* dp).filename,(* dp).extension,
+                   (dirptr2 + k)->filename,(dirptr2 + k)->extension,cl + i);
+          };
+         n = i;
+       };
+      for (i = 0;i < n;i++)
+       { newfat[cl + i] = (i + 1 < n) ? cl + i + 1 : eof;
+       };
+      used += n;
+    };
+   /* the allocated clusters, which are no part of the new FAT */
+   freed = 0;
+   for (cl = 2;cl < (unsigned int)clusters;cl += n)
+    { n = (unsigned int)clusters - cl;
+      n = decode_fats(cl,(n < FATBLOCK) ? n : FATBLOCK,fatlength,WORKFAT,
+                      fatptr2,block);
+      if (n == 0)
+       { break;
+       };
+      for (k = 0;k < n;k++)
+       { if ((block[k] != NOFAT) && (newfat[cl + k] == NOFAT))
+          { freed++; };
+       };
+    };
+   free(owner);
+   printf("%u files, %u clusters, %u overlaps\n",files,used,overlaps);
+   printf("%u clusters of subdirectories kept, %u allocated clusters become free\n",
+          kept,freed);
+   printf("Do You really want to replace the work FAT ? Y/N ");
+   c = getch();
+   printf("\n");
+   if (toupper(c) != 'Y')
+    { free(newfat);
+      return;
+    };
+   /* one pass in blocks, only the changed entries are written,
+      the owners are found once at the end */
+   hadowner = (ownerdir != NULL);
+   free(ownerdir); ownerdir = NULL;
+   changed = 0;
+   for (cl = 2;cl < (unsigned int)clusters;cl += n)
+    { n = (unsigned int)clusters - cl;
+      n = decode_fats(cl,(n < FATBLOCK) ? n : FATBLOCK,fatlength,WORKFAT,
+                      fatptr2,block);
+      if (n == 0)
+       { break;
+       };
+      for (k = 0;k < n;k++)
+       { if (block[k] != newfat[cl + k])
+          { set_fat_value(newfat[cl + k],cl + k,fatlength,WORKFAT,fatptr2);
+            changed++;
+          };
+       };
+    };
+   if (hadowner)
+    { build_ownerindex();
+    };
+   printf("%u FAT entries changed\n",changed);
+   free(newfat);
+ }
+
+int chk_exists(name,ext,dirptr2,entries)
+ char *name,*ext;
+ struct direntry_tp *dirptr2;
+ int entries;
+ { char full[NLENGTH + ELENGTH + 1];
+   int d;
+   sprintf(full,"%-8.8s%-3.3s",name,ext);
+   for (d = 0;d < entries;d++)
+    { if (memcmp((dirptr2 + d)->filename,full,NLENGTH + ELENGTH) == 0)
+       { return(!0);
+       };
+    };
+   return(0);
+ }
+
+void make_chkfiles(fatlength,fatptr2,btptr2,dirptr2)
+ int fatlength;
+ fatentry_tp * fatptr2;
+ bootsec_tp *btptr2;
+ struct direntry_tp *dirptr2;
+ { unsigned char *refd,*heads,*buffer;
+   struct direntry_tp *sub,*dp;
+   struct dirnode_tp *grown;
+   unsigned int cl,n,k,i,v,nheads,maxheads,csize,lastres,eof,loopstart,subcl,subn,number;
+   unsigned int e,entries;
+   unsigned int block[FATBLOCK];
+   int d,nd,freeslots,c;
+   long length;
+   char name[NLENGTH + 1],ext[ELENGTH + 1];
+   lastres = (fattyp == FAT12B) ? RESCLUST12 :
+             ((fattyp == FAT32B) ? RESCLUST32 : RESCLUST);
+   eof = lastres | 0x0F;
+   csize = secsize * (*btptr2).sectors_per_cluster;
+   /* each subdirectory is needed completely, the files within it
+      are no orphans */
+   if (refresh_dirtree(fatlength,fatptr2,btptr2) != 0)
+    { errormessage(BOOTERR,DIRTREEERR);
+      return;
+    };
+   for (nd = 1;nd < ndirnodes;nd++)
+    { if ((dirtree[nd].dir == NULL) || dirtree[nd].truncated)
+       { errormessage(BOOTERR,DIRTREEERR);
+         return;
+       };
+    };
+   refd = calloc(BITMAPSIZE(clusters) + 1,1);
+   heads = calloc(BITMAPSIZE(clusters) + 1,1);
+   if ((refd == NULL) || (heads == NULL))
+    { errormessage(FATALERR,NOMEM);
+      free(refd); free(heads);
+      return;
+    };
+   /* references by the main directory and by the subdirectories,
+      without "." and ".." */
+   for (nd = 0;nd < ndirnodes;nd++)
+    { dp = (nd == MAINNODE) ? dirptr2 : node_dir(nd);
+      entries = (nd == MAINNODE) ? (unsigned int)DIRENTRIES(btptr2) : node_entries(nd);
+      for (e = 0;(e < entries) && (dp[e].filename[0] != 0x00);e++)
+       { if (DIRFILE(dp + e) && (dp[e].filename[0] != '.'))
+          { SETBIT(refd,STARTCLUSTER(dp + e)); };
+       };
+    };
+   if ((fattyp == FAT32B) && ISCLUSTER((unsigned int)(*btptr2).root_cluster))
+    { SETBIT(refd,(unsigned int)(*btptr2).root_cluster);
+    };
+   /* in-degree pass in blocks : used clusters, which are no successor */
+   for (cl = 2;cl < (unsigned int)clusters;cl += n)
+    { n = (unsigned int)clusters - cl;
+      n = decode_fats(cl,(n < FATBLOCK) ? n : FATBLOCK,fatlength,WORKFAT,
+                      fatptr2,block);
+      if (n == 0)
+       { break;
+       };
+      for (k = 0;k < n;k++)
+       { v = block[k];
+         if (ISCLUSTER(v))
+          { SETBIT(refd,v); SETBIT(heads,cl + k); }
+         else if (v >= (lastres | 0x08))
+          { SETBIT(heads,cl + k); };
+       };
+    };
+   nheads = 0;
+   for (cl = 2;cl < (unsigned int)clusters;cl++)
+    { if (TESTBIT(refd,cl))
+       { CLRBIT(heads,cl); };
+      if (TESTBIT(heads,cl))
+       { nheads++; };
+    };
+   free(refd);
+   if (nheads == 0)
+    { printf("no orphan chains\n");
+      free(heads);
+      return;
+    };
+   for (d = 0,freeslots = 0;d < DIRENTRIES(btptr2);d++)
+    { if (((dirptr2 + d)->filename[0] == 0x00) || ((dirptr2 + d)->filename[0] == 0xE5))
+       { freeslots++; };
+    };
+   /* all in the main directory, or in a new subdirectory FOUND.nnn */
+   sub = NULL; buffer = NULL; subcl = NOFAT; subn = 0;
+   maxheads = nheads;
+   if ((unsigned int)freeslots < nheads)
+    { if (freeslots == 0)
+       { errormessage(BOOTERR,ROOTFULLERR);
+         free(heads);
+         return;
+       };
+      for (number = 0;number <= 999;number++)
+       { sprintf(ext,"%03u",number);
+         if (!chk_exists("FOUND",ext,dirptr2,DIRENTRIES(btptr2)))
+          { break;
+          };
+       };
+      if (number > 999)
+       { errormessage(BOOTERR,NONAMEERR);
+         free(heads);
+         return;
+       };
+      /* a subdirectory within a single allocation */
+      if (maxheads > DIRBUFMAX / sizeof(struct direntry_tp) - 2)
+       { maxheads = DIRBUFMAX / sizeof(struct direntry_tp) - 2;
+       };
+      subn = (unsigned int)(((long)(maxheads + 2) * sizeof(struct direntry_tp) + csize - 1) / csize);
+      if ((freemap == NULL) && (build_freeindex(fatlength,fatptr2) != 0))
+       { errormessage(FATALERR,NOMEM);
+         free(heads);
+         return;
+       };
+      if ((subcl = first_free_run(subn)) == NOFAT)
+       { errormessage(BOOTERR,SUBFREEERR);
+         free(heads);
+         return;
+       };
+      if ((buffer = calloc(subn,csize)) == NULL)
+       { errormessage(FATALERR,NOMEM);
+         free(heads);
+         return;
+       };
+      sub = (struct direntry_tp *)buffer;
+    };
+   printf("%u orphan chains, ",nheads);
+   if (sub != NULL)
+    { printf("the main directory is full, %u clusters at $(%x) for FOUND.%s\n",subn,subcl,ext);
+      if (maxheads < nheads)
+       { printf("just the first %u chains fit into FOUND.%s\n",maxheads,ext);
+       };
+    }
+   else
+    { printf("%d free entries of the main directory\n",freeslots);
+    };
+   printf("Do You really want to create the FILEnnnn.CHK entries ? Y/N ");
+   c = getch();
+   printf("\n");
+   if (toupper(c) != 'Y')
+    { free(heads); free(buffer);
+      return;
+    };
+   if (sub != NULL)
+    { /* FOUND.nnn is a modified node of the directory tree,
+         it is written with the write back */
+      grown = realloc(dirtree,(ndirnodes + 1) * sizeof(struct dirnode_tp));
+      if (grown == NULL)
+       { errormessage(FATALERR,NOMEM);
+         free(heads); free(buffer);
+         return;
+       };
+      dirtree = grown;
+      if ((dp = make_direntry("FOUND",ext,subcl,0L,btptr2,dirptr2)) == NULL)
+       { errormessage(BOOTERR,ROOTFULLERR);
+         free(heads); free(buffer);
+         return;
+       };
+      (* dp).attribute = 0x10;
+      mark_direntry(dp);
+      for (k = 0;k + 1 < subn;k++)
+       { set_fat_value(subcl + k + 1,subcl + k,fatlength,WORKFAT,fatptr2);
+       };
+      set_fat_value(eof,subcl + subn - 1,fatlength,WORKFAT,fatptr2);
+      fill_direntry(sub,".","",0x10,subcl,0L);
+      fill_direntry(sub + 1,"..","",0x10,0,0L);
+      memset(&dirtree[ndirnodes],0,sizeof(struct dirnode_tp));
+      dirtree[ndirnodes].start = subcl;
+      dirtree[ndirnodes].parent = MAINNODE;
+      dirtree[ndirnodes].depth = 1;
+      dirtree[ndirnodes].nclusters = subn;
+      dirtree[ndirnodes].entries = (unsigned int)(((long)subn * csize) / sizeof(struct direntry_tp));
+      dirtree[ndirnodes].dirty = !0;
+      sprintf(dirtree[ndirnodes].name,"FOUND.%s",ext);
+      dirtree[ndirnodes].dir = sub;
+      ndirnodes++;
+      printf("FOUND.%s : $(%5x)\n",ext,subcl);
+    };
+   number = 0; i = 0;
+   for (cl = 2;(cl < (unsigned int)clusters) && (i < maxheads);cl++)
+    { if (!TESTBIT(heads,cl))
+       { continue;
+       };
+      /* the shared chain walker, a loop is counted once */
+      length = chain_length(cl,fatlength,WORKFAT,fatptr2,&loopstart) * (long)csize;
+      for (;number <= 9999;number++)
+       { sprintf(name,"FILE%04u",number);
+         if ((sub != NULL) || !chk_exists(name,"CHK",dirptr2,DIRENTRIES(btptr2)))
+          { break;
+          };
+       };
+      if (number > 9999)
+       { errormessage(BOOTERR,NONAMEERR);
+         break;
+       };
+      number++;
+      if (sub != NULL)
+       { fill_direntry(sub + 2 + i,name,"CHK",0x20,cl,length);
+       }
+      else if (make_direntry(name,"CHK",cl,length,btptr2,dirptr2) == NULL)
+       { errormessage(BOOTERR,ROOTFULLERR);
+         break;
+       };
+      printf("%-8.8s.CHK : $(%5x) filelength $(%lx)\n",name,cl,length);
+      i++;
+    };
+   if (i < nheads)
+    { printf("%u of %u orphan chains are left\n",nheads - i,nheads);
+    };
+   free(heads);
+ }
+
+/******************/
+/* directory tree */
+/******************/
+
+void free_dirtree()
+ { int nd;
+   for (nd = 0;nd < ndirnodes;nd++)
+    { free(dirtree[nd].dir);
+    };
+   free(dirtree);
+   dirtree = NULL;
+   ndirnodes = 0;
+   dir_node = MAINNODE;
+   node_entry = 0;
+ }
+
+struct direntry_tp *node_dir(nd)
+ int nd;
+ { if ((nd == MAINNODE) || (nd >= ndirnodes))
+    { return(dirptr);
+    };
+   return(dirtree[nd].dir);
+ }
+
+unsigned int node_entries(nd)
+ int nd;
+ { if ((nd == MAINNODE) || (nd >= ndirnodes))
+    { return((unsigned int)DIRENTRIES(btptr));
+    };
+   return(dirtree[nd].entries);
+ }
+
+int find_dirnode(start)
+ unsigned int start;
+ { int nd;
+   for (nd = 0;nd < ndirnodes;nd++)
+    { if (dirtree[nd].start == start)
+       { return(nd);
+       };
+    };
+   return(-1);
+ }
+
+void mark_dirnode(dirptr2)
+ struct direntry_tp *dirptr2;
+ { int nd;
+   for (nd = 1;nd < ndirnodes;nd++)
+    { if ((dirtree[nd].dir != NULL) && (dirptr2 >= dirtree[nd].dir) &&
+          (dirptr2 < dirtree[nd].dir + dirtree[nd].entries))
+       { dirtree[nd].dirty = !0;
+         return;
+       };
+    };
+ }
+
+long dirnode_runs(nd,fatlength,fatptr2,btptr2,writing)
+ int nd,fatlength,writing;
+ fatentry_tp * fatptr2;
+ bootsec_tp *btptr2;
+ { unsigned int cl,first,next,run,i,n,csize;
+   unsigned char *dest,*data;
+   long transfers;
+   csize = (*btptr2).sectors_per_cluster * secsize;
+   n = dirtree[nd].nclusters;
+   transfers = 0;
+   cl = dirtree[nd].start;
+   for (i = 0;i < n;i += run)
+    { /* a contiguous run of the chain, by a single transfer */
+      first = cl; run = 1;
+      next = get_fat_value(cl,fatlength,WORKFAT,fatptr2);
+      while ((i + run < n) && (next == first + run))
+       { next = get_fat_value(next,fatlength,WORKFAT,fatptr2);
+         run++;
+       };
+      dest = (unsigned char *)dirtree[nd].dir + (unsigned long)i * csize;
+      if (writing)
+       { /* the clusters may be cached by the views */
+         cache_drop(clustosec(first,btptr2),(int)(run * (*btptr2).sectors_per_cluster));
+         if (abswrite((int)(toupper(drive) - 'A'),
+                      (int)(run * (*btptr2).sectors_per_cluster),
+                      clustosec(first,btptr2),dest) != 0)
+          { return(-1L);
+          };
+       }
+      else
+       { if ((data = get_clusters(first,run,dest,btptr2)) == NULL)
+          { return(-1L);
+          };
+         if (data != dest)
+          { memcpy(dest,data,(size_t)run * csize);
+          };
+       };
+      transfers++;
+      cl = next;
+    };
+   return(transfers);
+ }
+
+long read_dirnode(nd,fatlength,fatptr2,btptr2)
+ int nd,fatlength;
+ fatentry_tp * fatptr2;
+ bootsec_tp *btptr2;
+ { unsigned int csize,maxcl,loopstart;
+   long n;
+   csize = (*btptr2).sectors_per_cluster * secsize;
+   maxcl = DIRBUFMAX / csize;
+   if (maxcl == 0)
+    { maxcl = 1;
+    };
+   n = chain_length(dirtree[nd].start,fatlength,WORKFAT,fatptr2,&loopstart);
+   dirtree[nd].truncated = (n > (long)maxcl);
+   if (n > (long)maxcl)
+    { n = (long)maxcl;
+    };
+   free(dirtree[nd].dir);
+   dirtree[nd].dir = NULL;
+   dirtree[nd].nclusters = (unsigned int)n;
+   dirtree[nd].entries = 0;
+   dirtree[nd].dirty = 0;
+   if (n == 0)
+    { return(0L);
+    };
+   dirtree[nd].dir = calloc((size_t)n,csize);
+   if (dirtree[nd].dir == NULL)
+    { dirtree[nd].nclusters = 0;
+      return(-1L);
+    };
+   dirtree[nd].entries = (unsigned int)((n * csize) / sizeof(struct direntry_tp));
+   return(dirnode_runs(nd,fatlength,fatptr2,btptr2,0));
+ }
+
+int write_dirnode(nd,fatlength,fatptr2,btptr2)
+ int nd,fatlength;
+ fatentry_tp * fatptr2;
+ bootsec_tp *btptr2;
+ { if (dirtree[nd].dir == NULL)
+    { return(0);
+    };
+   if (dirnode_runs(nd,fatlength,fatptr2,btptr2,!0) < 0)
+    { return(!0);
+    };
+   dirtree[nd].dirty = 0;
+   return(0);
+ }
+
+int load_dirtree(fatlength,fatptr2,btptr2)
+ int fatlength;
+ fatentry_tp * fatptr2;
+ bootsec_tp *btptr2;
+ { struct dirnode_tp *grown;
+   struct direntry_tp *dp;
+   unsigned char *seen;
+   unsigned int e,entries,start,i;
+   int nd,maxnodes,k,noerr;
+   long reads,r;
+   char *s;
+   free_dirtree();
+   seen = calloc(BITMAPSIZE(clusters) + 1,1);
+   dirtree = calloc(DIRNODES,sizeof(struct dirnode_tp));
+   if ((seen == NULL) || (dirtree == NULL))
+    { free(seen); free(dirtree); dirtree = NULL;
+      errormessage(FATALERR,NOMEM);
+      return(!0);
+    };
+   maxnodes = DIRNODES;
+   ndirnodes = 1;
+   dirtree[MAINNODE].parent = -1;
+   strcpy(dirtree[MAINNODE].name,"\\");
+   if ((fattyp == FAT32B) && (rootclusters != NULL))
+    { for (i = 0;i < (unsigned int)(dirsecs / (*btptr2).sectors_per_cluster);i++)
+       { if (ISCLUSTER(rootclusters[i]))
+          { SETBIT(seen,rootclusters[i]);
+          };
+       };
+    };
+   reads = 0; noerr = 0;
+   /* the nodes are a work list: each directory, as soon as it is read,
+      appends its subdirectories, which are read later on */
+   for (nd = 0;nd < ndirnodes;nd++)
+    { if (nd != MAINNODE)
+       { if ((r = read_dirnode(nd,fatlength,fatptr2,btptr2)) < 0)
+          { noerr = !0;
+            continue;
+          };
+         reads += r;
+       };
+      dp = node_dir(nd);
+      entries = node_entries(nd);
+      for (e = 0;(e < entries) && (dp[e].filename[0] != 0x00);e++)
+       { if (!DIRFILE(dp + e) || ((dp[e].attribute & SUBDIR) == 0) ||
+             (dp[e].filename[0] == '.'))
+          { continue;
+          };
+         /* a subdirectory is read once, also if it is linked twice */
+         start = STARTCLUSTER(dp + e);
+         if (TESTBIT(seen,start))
+          { continue;
+          };
+         SETBIT(seen,start);
+         if (ndirnodes == maxnodes)
+          { grown = realloc(dirtree,(maxnodes + DIRNODES) * sizeof(struct dirnode_tp));
+            if (grown == NULL)
+             { free(seen);
+               errormessage(FATALERR,NOMEM);
+               return(!0);
+             };
+            dirtree = grown;
+            maxnodes += DIRNODES;
+          };
+         memset(&dirtree[ndirnodes],0,sizeof(struct dirnode_tp));
+         dirtree[ndirnodes].start = start;
+         dirtree[ndirnodes].parent = nd;
+         dirtree[ndirnodes].depth = dirtree[nd].depth + 1;
+         s = dirtree[ndirnodes].name;
+         for (k = 0;(k < NLENGTH) && (dp[e].filename[k] != ' ');k++)
+          { *s++ = (char)dp[e].filename[k];
+          };
+         if (dp[e].extension[0] != ' ')
+          { *s++ = '.';
+            for (k = 0;(k < ELENGTH) && (dp[e].extension[k] != ' ');k++)
+             { *s++ = (char)dp[e].extension[k];
+             };
+          };
+         *s = '\0';
+         ndirnodes++;
+       };
+    };
+   free(seen);
+   printf("%d directories, %ld reads\n",ndirnodes,reads);
+   if (noerr)
+    { errormessage(BOOTERR,DIRTREEERR);
+    };
+   return(noerr);
+ }
+
+int put_dirtree(fatlength,fatptr2,btptr2)
+ int fatlength;
+ fatentry_tp * fatptr2;
+ bootsec_tp *btptr2;
+ { int nd,noerr;
+   noerr = 0;
+   for (nd = 1;nd < ndirnodes;nd++)
+    { if (dirtree[nd].dirty && (write_dirnode(nd,fatlength,fatptr2,btptr2) != 0))
+       { noerr = !0;
+       };
+    };
+   return(noerr);
+ }
+
+int refresh_dirtree(fatlength,fatptr2,btptr2)
+ int fatlength;
+ fatentry_tp * fatptr2;
+ bootsec_tp *btptr2;
+ { int nd,dirty;
+   unsigned int start;
+   dirty = 0;
+   for (nd = 1;nd < ndirnodes;nd++)
+    { dirty |= dirtree[nd].dirty;
+    };
+   /* modified subdirectories are kept, up to the write back */
+   if (!dirty)
+    { start = (ndirnodes > 0) ? dirtree[dir_node].start : 0;
+      if ((load_dirtree(fatlength,fatptr2,btptr2) != 0) && (ndirnodes == 0))
+       { return(!0);
+       };
+      if ((nd = find_dirnode(start)) > 0)
+       { dir_node = nd;
+       };
+    };
+   return(ndirnodes == 0);
+ }
+
+void display_nodepath(nd)
+ int nd;
+ { if (nd <= MAINNODE)
+    { printf("\\");
+      return;
+    };
+   if (dirtree[nd].parent != MAINNODE)
+    { display_nodepath(dirtree[nd].parent);
+    };
+   printf("\\%s",dirtree[nd].name);
+ }
+
+void show_dirtree(fatlength,fatptr2,btptr2)
+ int fatlength;
+ fatentry_tp * fatptr2;
+ bootsec_tp *btptr2;
+ { int nd;
+   unsigned int e,used;
+   struct direntry_tp *dp;
+   if (refresh_dirtree(fatlength,fatptr2,btptr2) != 0)
+    { return;
+    };
+   for (nd = 0;nd < ndirnodes;nd++)
+    { dp = node_dir(nd);
+      used = 0;
+      for (e = 0;(e < node_entries(nd)) && (dp[e].filename[0] != 0x00);e++)
+       { if ((dp[e].filename[0] != 0xE5) && (dp[e].filename[0] != '.'))
+          { used++;
+          };
+       };
+      printf("%4x: $(%5x) %4u entries %c%c %*s",nd,dirtree[nd].start,used,
+             dirtree[nd].dirty ? '*' : ' ',dirtree[nd].truncated ? '!' : ' ',
+             2 * dirtree[nd].depth,"");
+      display_nodepath(nd);
+      printf("\n");
+    };
+ }
+
+int open_subdir(dirptr2,fatlength,fatptr2,btptr2)
+ struct direntry_tp *dirptr2;
+ int fatlength;
+ fatentry_tp * fatptr2;
+ bootsec_tp *btptr2;
+ { int nd;
+   unsigned int start;
+   if (((* dirptr2).filename[0] == 0x00) || ((* dirptr2).filename[0] == 0xE5) ||
+       (((* dirptr2).attribute & SUBDIR) == 0))
+    { errormessage(BOOTERR,NOSUBDIRERR);
+      return(0);
+    };
+   if ((ndirnodes == 0) && (load_dirtree(fatlength,fatptr2,btptr2) != 0) &&
+       (ndirnodes == 0))
+    { return(0);
+    };
+   /* ".." of a subdirectory of the main directory has the startcluster 0 */
+   start = STARTCLUSTER(dirptr2);
+   if ((fattyp == FAT32B) && (start == (unsigned int)(*btptr2).root_cluster))
+    { start = 0;
+    };
+   if ((nd = find_dirnode(start)) < 0)
+    { errormessage(BOOTERR,NOSUBDIRERR);
+      return(0);
+    };
+   dir_node = nd;
+   node_entry = 0;
+   return(!0);
+ }
+
+/***************/
+/* edit script */
+/***************/
+
+int batch_parse(line,edit)
+ char *line;
+ struct batchedit_tp *edit;
+ { char kind[4],field[8],text[16];
+   unsigned long lastres;
+   lastres = (fattyp == FAT12B) ? RESCLUST12 :
+             ((fattyp == FAT32B) ? RESCLUST32 : RESCLUST);
+   if ((sscanf(line," %3s",kind) < 1) || (kind[0] == ';'))
+    { return(1);
+    };
+   strupr(kind);
+   if (strcmp(kind,"F") == 0)
+    { /* F index value */
+      if (sscanf(line," %*s %lx %15s",&(*edit).index,text) != 2)
+       { return(-1);
+       };
+      (*edit).kind = EDITFAT;
+      (*edit).field = 0;
+      strupr(text);
+      if (strcmp(text,"FREE") == 0)
+       { (*edit).value = NOFAT; }
+      else if (strcmp(text,"EOF") == 0)
+       { (*edit).value = lastres | 0x0F; }
+      else if (strcmp(text,"BAD") == 0)
+       { (*edit).value = lastres | 0x07; }
+      else if (sscanf(text,"%lx",&(*edit).value) != 1)
+       { return(-1);
+       };
+      return(0);
+    };
+   if (strcmp(kind,"D") == 0)
+    { /* D entry field value */
+      if (sscanf(line," %*s %lx %7s %15s",&(*edit).index,field,text) != 3)
+       { return(-1);
+       };
+      (*edit).kind = EDITDIR;
+      (*edit).value = 0;
+      strupr(field);
+      if ((strcmp(field,"NAME") == 0) || (strcmp(field,"EXT") == 0))
+       { (*edit).field = (field[0] == 'N') ? FLDNAME : FLDEXT;
+         if (strlen(text) > (((*edit).field == FLDNAME) ? NLENGTH : ELENGTH))
+          { return(-1);
+          };
+         strcpy((*edit).text,text);
+         return(0);
+       };
+      if (strcmp(field,"ATTR") == 0)
+       { (*edit).field = FLDATTR; }
+      else if (strcmp(field,"START") == 0)
+       { (*edit).field = FLDSTART; }
+      else if (strcmp(field,"LENGTH") == 0)
+       { (*edit).field = FLDLENGTH; }
+      else
+       { return(-1);
+       };
+      return((sscanf(text,"%lx",&(*edit).value) == 1) ? 0 : -1);
+    };
+   return(-1);
+ }
+
+int batch_load(filename,edits)
+ char *filename;
+ struct batchedit_tp **edits;
+ { FILE *fp;
+   char line[LINELEN];
+   struct batchedit_tp *more;
+   int n,size,nline,error2;
+   *edits = NULL;
+   if ((fp = fopen(filename,"r")) == NULL)
+    { errormessage(BOOTERR,SCRIPTERR);
+      return(-1);
+    };
+   n = 0; size = 0; nline = 0; error2 = 0;
+   while (fgets(line,LINELEN,fp) != NULL)
+    { nline++;
+      if (n == size)
+       { size += BATCHCHUNK;
+         if ((more = realloc(*edits,size * sizeof(struct batchedit_tp))) == NULL)
+          { errormessage(FATALERR,NOMEM);
+            error2 = !0;
+            break;
+          };
+         *edits = more;
+       };
+      (*edits)[n].line = nline;
+      switch (batch_parse(line,*edits + n))
+       { case 0  : { n++; break;};
+         case 1  : { break;};
+         default :
+          { printf("line %d : %s",nline,line);
+            errormessage(BOOTERR,BATCHERR);
+            error2 = !0;
+            break;};
+       };
+      if (error2)
+       { break;
+       };
+    };
+   fclose(fp);
+   if (error2)
+    { free(*edits); *edits = NULL;
+      return(-1);
+    };
+   return(n);
+ }
+
+int batch_check(edits,n,fatlength)
+ struct batchedit_tp *edits;
+ int n,fatlength;
+ { int i,error2;
+   unsigned long offset;
+   unsigned int sectors,free_slots;
+   unsigned char *touched;
+   for (i = 0;i < n;i++)
+    { error2 = 0;
+      if (edits[i].kind == EDITFAT)
+       { if ((edits[i].value > FAT32MASK) ||
+             wrong_fat_value((unsigned int)edits[i].value,
+                             (unsigned int)edits[i].index))
+          { error2 = WRONGFENTRY;
+          };
+       }
+      else
+       { if ((edits[i].index >= (unsigned long)DIRENTRIES(btptr)) ||
+             ((edits[i].field == FLDATTR) && (edits[i].value > 0xFF)) ||
+             ((edits[i].field == FLDSTART) && (edits[i].value != NOFAT) &&
+              !ISCLUSTER(edits[i].value)))
+          { error2 = WRONGDENTRY;
+          };
+       };
+      if (error2)
+       { printf("line %d : ",edits[i].line);
+         errormessage(BOOTERR,error2);
+         errormessage(BOOTERR,BATCHERR);
+         return(!0);
+       };
+    };
+   if (fatpaged)
+    { /* all modified FAT sectors must fit into the sector cache */
+      if ((touched = calloc(BITMAPSIZE(fatlength) + 1,1)) == NULL)
+       { errormessage(FATALERR,NOMEM);
+         return(!0);
+       };
+      sectors = 0;
+      for (i = 0;i < n;i++)
+       { if (edits[i].kind == EDITFAT)
+          { offset = (fattyp == FAT12B) ? ((edits[i].index * 3) >> 1) :
+                     (edits[i].index * (fattyp >> 3));
+            /* the first and the last byte of the entry */
+            if (!TESTBIT(touched,offset / secsize))
+             { SETBIT(touched,offset / secsize); sectors++; };
+            offset += (fattyp == FAT32B) ? 3 : 1;
+            if (((offset / secsize) < (unsigned long)fatlength) &&
+                !TESTBIT(touched,offset / secsize))
+             { SETBIT(touched,offset / secsize); sectors++; };
+          };
+       };
+      free(touched);
+      free_slots = 0;
+      for (i = 0;i < cacheslots;i++)
+       { if (!cache[i].dirty) { free_slots++; };
+       };
+      if (sectors + FATWINDOW > free_slots)
+       { errormessage(BOOTERR,CACHEERR);
+         errormessage(BOOTERR,BATCHERR);
+         return(!0);
+       };
+    };
+   return(0);
  }
 
-int put_fat_value(fvalue,selfentry,fatlength,fatnumber,fatptr2)
- int fvalue,selfentry,fatlength,fatnumber;
+void batch_apply(edits,n,fatlength,fatptr2,dirptr2)
+ struct batchedit_tp *edits;
+ int n,fatlength;
  fatentry_tp * fatptr2;
- { int error1;
-   int c;
-   error1 = 0;
-   printf("Do You really want to modify the FAT ? Y/N ");
-   c = getch();
-   printf("\n");
-   if (toupper(c)=='Y')
-    { switch (fattyp)
-    { case FAT12B:
-       { error1 =
-          put_fatentry12(fvalue,selfentry,fatlength,fatnumber,fatptr2);
-        break;}
-      case FAT16B:
-       { error1 =
-           put_fatentry16(fvalue,selfentry,fatlength,fatnumber,
-                (fatentry16_tp *)fatptr2);break;}
-      default:
-       {errormessage(BOOTERR,WRONGFAT);exit(1);break;};
+ struct direntry_tp *dirptr2;
+ { int i,k;
+   struct direntry_tp *dirptr3;
+   for (i = 0;i < n;i++)
+    { if (edits[i].kind == EDITFAT)
+       { set_fat_value((unsigned int)edits[i].value,(int)edits[i].index,
+                       fatlength,WORKFAT,fatptr2);
+         continue;
+       };
+      dirptr3 = dirptr2 + edits[i].index;
+      switch (edits[i].field)
+       { case FLDNAME:
+          { for (k = 0;k < NLENGTH;k++)
+             { (* dirptr3).filename[k] = (k < (int)strlen(edits[i].text)) ?
+                                         edits[i].text[k] : ' ';
+             };
+            break;};
+         case FLDEXT:
+          { for (k = 0;k < ELENGTH;k++)
+             { (* dirptr3).extension[k] = (k < (int)strlen(edits[i].text)) ?
+                                          edits[i].text[k] : ' ';
+             };
+            break;};
+         case FLDATTR:
+          { (* dirptr3).attribute = (unsigned char)edits[i].value;
+            break;};
+         case FLDSTART:
+          { (* dirptr3).startcluster = (word_tp)(edits[i].value & 0xFFFF);
+            if (fattyp == FAT32B)
+             { (* dirptr3).startcluster_high = (word_tp)(edits[i].value >> 16);
+             };
+            break;};
+         default:
+          { (* dirptr3).filelength = (dword_tp)edits[i].value;
+            break;};
+       };
+      mark_direntry(dirptr3);
     };
+ }
+
+void run_batch(fatptr2,btptr2,dirptr2)
+ fatsec_tp *fatptr2;
+ bootsec_tp *btptr2;
+ struct direntry_tp *dirptr2;
+ { char filename[IMGNAMELEN];
+   struct batchedit_tp *edits;
+   struct direntry_tp *olddir;
+   unsigned int *oldfat;
+   int n,c,i,written;
+   printf("? edit script file : ");
+   /* without the end of the line, which is not an answer */
+   scanf(" %79s%*c",filename);
+   if ((n = batch_load(filename,&edits)) < 0)
+    { return;
+    };
+   /* all or nothing */
+   if (batch_check(edits,n,FATLENGTH(btptr2)) == 0)
+    { printf("Do You really want to do %d edits ? Y/N ",n);
+      c = getch();
+      printf("\n");
+      if (toupper(c) == 'Y')
+       { /* the old FAT values and direntries, for the undo */
+         oldfat = calloc(n + 1,sizeof(unsigned int));
+         olddir = calloc(n + 1,sizeof(struct direntry_tp));
+         if ((oldfat == NULL) || (olddir == NULL))
+          { free(oldfat); free(olddir); free(edits);
+            errormessage(FATALERR,NOMEM);
+            return;
+          };
+         for (i = 0;i < n;i++)
+          { if (edits[i].kind == EDITFAT)
+             { oldfat[i] = get_fat_value((int)edits[i].index,FATLENGTH(btptr2),
+                                         WORKFAT,(fatentry_tp *)fatptr2);
+             }
+            else
+             { olddir[i] = *(dirptr2 + edits[i].index);
+             };
+          };
+         batch_apply(edits,n,FATLENGTH(btptr2),(fatentry_tp *)fatptr2,dirptr2);
+         if ((written = writeback(fatptr2,btptr2,dirptr2)) != 0)
+          { /* declined or failed: undo the FAT and the directory,
+               in reverse order, as an entry may be edited twice */
+            for (i = n - 1;i >= 0;i--)
+             { if (edits[i].kind == EDITFAT)
+                { set_fat_value(oldfat[i],(int)edits[i].index,
+                                FATLENGTH(btptr2),WORKFAT,(fatentry_tp *)fatptr2);
+                }
+               else
+                { *(dirptr2 + edits[i].index) = olddir[i];
+                  if (written < 0)
+                   { /* declined: the directory sectors are read again,
+                        they are not modified */
+                     owner_direntry(dirptr2 + edits[i].index);
+                   }
+                  else
+                   { mark_direntry(dirptr2 + edits[i].index);
+                   };
+                };
+             };
+            printf("the %d edits are undone\n",n);
+          };
+         free(oldfat); free(olddir);
+       };
+    };
+   free(edits);
+ }
+
+void show_freespace()
+ { unsigned int n,start;
+   if (freemap == NULL)
+    { errormessage(BOOTERR,FREEERR);
+      return;
+    };
+   printf("free clusters     : %u of %u\n",freecnt[1],(unsigned int)clusters - 2);
+   printf("largest free run  : %u clusters\n",freemax[1]);
+   n = 1;
+   printf("? number of contiguous free clusters : ");
+   scanf("%u",&n);
+   start = first_free_run(n);
+   if (start == NOFAT)
+    { printf("no free run of %u clusters\n",n);
+    }
+   else
+    { printf("first free run    : $(%5x) ... $(%5x)\n",start,start + n - 1);
+      /* for the FAT menu */
+      fat_entry = start;
     };
-   return(error1);
  }
 
 /*************************/
@@ -1137,7 +6079,11 @@ int show_direntry_options(dirptr2)
  { int c;
    printf("\n");
    printf("*******************************DIRENTRY*MENUE*****************************\n");
-   printf("->$(%4x):",dir_entry);
+   if (dir_node != MAINNODE)
+    { display_nodepath(dir_node);
+      printf("\n");
+    };
+   printf("->$(%4x):",(dir_node == MAINNODE) ? dir_entry : node_entry);
    display_direntry(!0,dirptr2);
    printf("**************************************************************************\n");
    printf("0 = exit this menu\n");
@@ -1149,8 +6095,10 @@ int show_direntry_options(dirptr2)
    printf("6 = change status\n");
    printf("7 = enter new filelength\n");
    printf("8 = recalculate new filelength\n");
+   printf("9 = open the subdirectory of the direntry\n");
    printf("+ = select next direntry\n");
    printf("- = select previous direntry\n");
+   printf("T = display the directory tree\n");
    printf("**************************************************************************\n");
    c = getch();    /* ansi-c specific */
    c = toupper(c); /* for MSC, getch+toupper are not 
@@ -1158,6 +6106,7 @@ int show_direntry_options(dirptr2)
    switch (c)
     { case '+' : { c = 10;break;};
       case '-' : { c = 11;break;};
+      case 'T' : { c = 12;break;};
       default  : {c = c - (int)'0'; break;};
     };
    return(c);
@@ -1192,6 +6141,7 @@ void get_name(dirptr2)
     for (k = strlen(ext);k<ELENGTH;k++)
     { (* dirptr2).extension[k] = ' ';
     };
+    mark_direntry(dirptr2);
   }
 
 void get_time(dirptr2)
@@ -1213,6 +6163,7 @@ void get_time(dirptr2)
     (* dirptr2).hour =  ((2<<(HOR+1))-1) & hour;
     (* dirptr2).minute = ((2<<(MNU+1))-1) & minute;
     (* dirptr2).second = ((2<<(SEC+1))-1) & second;
+    mark_direntry(dirptr2);
   }
 
 void get_date(dirptr2)
@@ -1231,6 +6182,7 @@ void get_date(dirptr2)
     (* dirptr2).year = ((2<<(YER+1))-1) & (year - 80);
     (* dirptr2).month = ((2<<(MON+1))-1) & month;
     (* dirptr2).day = ((2<<(DAY+1))-1) & day;
+    mark_direntry(dirptr2);
   }
 
 void change_status(dirptr2)
@@ -1247,6 +6199,7 @@ void change_status(dirptr2)
         printf("\n");
         if ( (c == 'Y') || (c == 'y'))
           { (* dirptr2).filename[0] = (unsigned char)0xE5;
+            mark_direntry(dirptr2);
           };
       };
        }; /* switch */
@@ -1312,6 +6265,7 @@ void change_attributes(dirptr2)
          { (* dirptr2).attribute = (* dirptr2).attribute | BIT7; };
      };
      };
+    mark_direntry(dirptr2);
   }
 
 void enter_filelength(dirptr2)
@@ -1322,6 +6276,7 @@ void enter_filelength(dirptr2)
    printf("? entry number : $");
    scanf("%lx",&entry);
    (* dirptr2).filelength = entry;
+   mark_direntry(dirptr2);
  }
 
 void calc_filelength(fatlength,fatnumber,fatptr2,btptr2,dirptr2)
@@ -1330,29 +6285,13 @@ void calc_filelength(fatlength,fatnumber,fatptr2,btptr2,dirptr2)
  bootsec_tp *btptr2;
  struct direntry_tp *dirptr2;
  { long laenge;
-   int fatvalue,c;
-   laenge = 0;
-    /* if the upper limit of the filelength is reached, abort */
-   fatvalue = (* dirptr2).startcluster;
-   while ( (fatvalue != EOFAT) && (fatvalue != NOFAT) &&
-       (laenge < (long)clusters))
-       { switch (fattyp)
-         { case FAT12B:
-        {fatvalue =
-             get_fatentry12(fatvalue,fatlength,fatnumber,fatptr2);
-         break;}
-           case FAT16B:
-        {fatvalue =
-             get_fatentry16(fatvalue,fatlength,
-                    fatnumber,(fatentry16_tp *)fatptr2);
-         break;}
-           default:
-        {errormessage(BOOTERR,WRONGFAT);exit(1);break;};
-         };
-         laenge++;
-       };
-   if (laenge == (long)clusters)
+   unsigned int loopstart;
+   int c;
+   laenge = chain_length(STARTCLUSTER(dirptr2),fatlength,fatnumber,
+                         (fatentry_tp *)fatptr2,&loopstart);
+   if (loopstart != NOFAT)
     { errormessage(BOOTERR,FATLOOP);
+      printf("loop at $(%5x), chain of %ld clusters\n",loopstart,laenge);
     }
    else
     { laenge = laenge * (long)(*btptr2).sectors_per_cluster *
@@ -1362,6 +6301,7 @@ void calc_filelength(fatlength,fatnumber,fatptr2,btptr2,dirptr2)
       printf("\n");
       if (toupper(c) == 'Y')
        { (* dirptr2).filelength = laenge;
+         mark_direntry(dirptr2);
        }
     };
  }
@@ -1378,15 +6318,15 @@ void show_bootinfo(btptr2)
 void show_maindir(dirptr2,btptr2)
  struct direntry_tp *dirptr2;
  bootsec_tp *btptr2;
- { display_dir((*btptr2).number_of_direntries,dirptr2);
+ { display_dir(DIRENTRIES(btptr2),dirptr2);
  }
 
 void show_direntries_fatentries(fatptr2,btptr2,dirptr2)
  fatsec_tp *fatptr2;
  bootsec_tp *btptr2;
  struct direntry_tp *dirptr2;
- { display_direntries_fatentries(!0,(*btptr2).sectors_per_fat,WORKFAT,
-                 (*btptr2).number_of_direntries,
+ { display_direntries_fatentries(!0,FATLENGTH(btptr2),WORKFAT,
+                 DIRENTRIES(btptr2),
                  (fatentry_tp *)fatptr2,dirptr2);
  }
 
@@ -1395,33 +6335,41 @@ void modify_direntry(fatptr2,btptr2,dirptr3)
  bootsec_tp *btptr2;
  struct direntry_tp *dirptr3;
  { int choice;
+   unsigned int *entry,entries;
    struct direntry_tp *dirptr2;
    choice = 0;
    /* the real menu functions */
    do
-    { dirptr2 = dirptr3 + dir_entry;
+    { /* the main directory, or a subdirectory of the directory tree */
+      entry = (dir_node == MAINNODE) ? &dir_entry : &node_entry;
+      entries = node_entries(dir_node);
+      dirptr2 = ((dir_node == MAINNODE) ? dirptr3 : node_dir(dir_node)) + *entry;
       choice = show_direntry_options(dirptr2);
       switch (choice)
        { case 0  : { break; };
-     case 1  : { dir_entry = ask_dentry(dir_entry,btptr2);break;};
+     case 1  : { *entry = ask_direntry(*entry,entries);break;};
      case 2  : { get_name(dirptr2);break;};
      case 3  : { get_time(dirptr2);break;};
      case 4  : { get_date(dirptr2);break;};
      case 5  : { change_attributes(dirptr2);break;};
      case 6  : { change_status(dirptr2);break;};
      case 7  : { enter_filelength(dirptr2);break;};
-     case 8  : { calc_filelength((*btptr2).sectors_per_fat,WORKFAT,
+     case 8  : { calc_filelength(FATLENGTH(btptr2),WORKFAT,
                      fatptr2,btptr2,dirptr2);break;};
-     case 10 : { if (dir_entry < ((*btptr2).number_of_direntries-1))
-               {dir_entry++;break;}
+     case 9  : { open_subdir(dirptr2,FATLENGTH(btptr2),
+                     (fatentry_tp *)fatptr2,btptr2);break;};
+     case 10 : { if (*entry < (entries-1))
+               {(*entry)++;break;}
               else
                {errormessage(BOOTERR,WRONGDENTRY);};
              break;};
-     case 11 : { if (dir_entry >0)
-               {dir_entry--;break;}
+     case 11 : { if (*entry >0)
+               {(*entry)--;break;}
               else
                {errormessage(BOOTERR,WRONGDENTRY);};
              break;};
+     case 12 : { show_dirtree(FATLENGTH(btptr2),
+                     (fatentry_tp *)fatptr2,btptr2);break;};
      default : { break;};
        };
     } while (choice != 0);
@@ -1438,7 +6386,7 @@ void modify_fatentry(fatptr2,btptr2,dirptr3)
    do
     { dirptr2 = dirptr3 + dir_entry;
       choice = show_fat_options(fat_entry,dir_entry,
-                (*btptr2).sectors_per_fat,WORKFAT,
+                FATLENGTH(btptr2),WORKFAT,
                 (fatentry_tp *)fatptr2,dirptr2);
       switch (choice)
        { case 0  : { break; };
@@ -1467,20 +6415,20 @@ void modify_fatentry(fatptr2,btptr2,dirptr3)
                break;
            };
      case 5  : { enter_fatentry(fat_entry,
-             (*btptr2).sectors_per_fat,WORKFAT,fatptr2);
+             FATLENGTH(btptr2),WORKFAT,fatptr2);
              break;};
      case 6  : { link_startcluster(fat_entry,dirptr2); break;};
      case 10 : { st_fat_entry = fat_entry;break;};
      case 11 : { st_fat_value = get_fat_value(fat_entry,
-                      (*btptr2).sectors_per_fat,WORKFAT,
+                      FATLENGTH(btptr2),WORKFAT,
                       (fatentry_tp *)fatptr2);break;};
      case 12 : { put_fat_value(st_fat_entry,fat_entry,
-                  (*btptr2).sectors_per_fat,WORKFAT,
+                  FATLENGTH(btptr2),WORKFAT,
                   (fatentry_tp *)fatptr2);break;};
      case 13 : { put_fat_value(st_fat_value,fat_entry,
-                  (*btptr2).sectors_per_fat,WORKFAT,
+                  FATLENGTH(btptr2),WORKFAT,
                   (fatentry_tp *)fatptr2);break;};
-     case 14 : { if (dir_entry < ((*btptr2).number_of_direntries-1))
+     case 14 : { if (dir_entry < (DIRENTRIES(btptr2)-1))
                {dir_entry++;break;}
               else
                {errormessage(BOOTERR,WRONGDENTRY);};
@@ -1502,13 +6450,43 @@ void modify_fatentry(fatptr2,btptr2,dirptr3)
              break;};
      case 18 : { unsigned int x_entry;
              x_entry = get_fat_value(fat_entry,
-                      (*btptr2).sectors_per_fat,WORKFAT,
+                      FATLENGTH(btptr2),WORKFAT,
                       (fatentry_tp *)fatptr2);
              if (x_entry < RESCLUST)
               { fat_entry = x_entry;
               };
              break;};
-     case 19  : {fat_entry = (* dirptr2).startcluster;
+     case 19  : {fat_entry = STARTCLUSTER(dirptr2);
+             break;};
+     case 20  : {if ((ownerdir != NULL) && 
+                     ((unsigned int)fat_entry < (unsigned int)clusters) &&
+                     (ownerdir[fat_entry] != NOOWNER))
+               { dir_entry = ownerdir[fat_entry];
+               }
+              else
+               { errormessage(BOOTERR,NOOWNERERR);
+               };
+             break;};
+     case 21  : { link_run(fat_entry,FATLENGTH(btptr2),
+                           (fatentry_tp *)fatptr2,btptr2,dirptr2);
+             break;};
+     case 22  : { unsigned int x_entry;
+             if (classmap == NULL)
+              { errormessage(BOOTERR,NOCLASSERR);
+              }
+             else if ((x_entry = next_text_cluster(fat_entry,
+                           FATLENGTH(btptr2),(fatentry_tp *)fatptr2)) != NOFAT)
+              { fat_entry = x_entry;
+              }
+             else
+              { errormessage(BOOTERR,NOTEXTERR);
+              };
+             break;};
+     case 23  : { fat_entry = suggest_next(fat_entry,FATLENGTH(btptr2),
+                           (fatentry_tp *)fatptr2,btptr2);
+             break;};
+     case 24  : { fat_entry = search_content(fat_entry,FATLENGTH(btptr2),
+                           (fatentry_tp *)fatptr2,btptr2);
              break;};
 
      default : { break;};
@@ -1519,7 +6497,7 @@ void modify_fatentry(fatptr2,btptr2,dirptr3)
 void show_fats(fatptr2,btptr2)
  fatsec_tp *fatptr2;
  bootsec_tp *btptr2;
- { display_fats(clusters, (*btptr2).sectors_per_fat,WORKFAT,
+ { display_fats(clusters, FATLENGTH(btptr2),WORKFAT,
         (fatentry_tp *)fatptr2);
  }
 
@@ -1539,11 +6517,16 @@ unsigned int ask_fentry(old)
 unsigned int ask_dentry(old,btptr2)
  unsigned int old;
  bootsec_tp *btptr2;
+ { return(ask_direntry(old,(unsigned int)DIRENTRIES(btptr2)));
+ }
+
+unsigned int ask_direntry(old,entries)
+ unsigned int old,entries;
  { unsigned entry;
    entry = old; /* old value */
    printf("? entry number : $");
    scanf("%x",&entry);
-   if ((*btptr2).number_of_direntries > entry)
+   if (entries > entry)
     { return(entry);}
    else
     { errormessage(BOOTERR,WRONGDENTRY);
@@ -1559,7 +6542,17 @@ char change_logdrive()
    if (((dr >= (int)'A') && (dr <= toupper((int)lastdrive))) ||
        ((dr >= (int)'a') && (dr <= tolower((int)lastdrive))))
     {drc = (char)dr;
-     log_ok = 0; bootlog_ok = 0; }
+     log_ok = 0; bootlog_ok = 0;
+#ifdef IMGDISK
+     { char imgname[IMGNAMELEN];
+       printf("? image file for <%c:> : ",toupper(dr));
+       scanf(" %79s",imgname);
+       if (absopen((int)(toupper(dr) - 'A'),imgname) != NULL)
+        { errormessage(BOOTERR,IMGERR);
+          drc = drive; };
+     };
+#endif
+    }
    else
     {drc = drive;};
    return(drc);
@@ -1590,12 +6583,42 @@ int show_main_options()
    printf("8 = modify/show directory entry \n");
    printf("9 = FAT menu\n");
    printf("C = Copy FAT to second FAT\n");
+   printf("S = sector cache statistics\n");
+   printf("F = free space\n");
+   printf("K = check FAT ( cross-links, lost clusters, bad chain ends )\n");
+   printf("D = compare FATs, repair the work FAT by majority vote\n");
+   printf("E = edit script ( F entry value / D direntry field value )\n");
+   printf("T = classify the contents of all clusters ( text, binary, ... )\n");
+   printf("R = reassemble orphaned text clusters into files\n");
+   printf("M = search all clusters for the patterns of a file ( hit matrix )\n");
+   printf("H = find the headers of binary files ( EXE, ZIP, ARC, GIF, ... )\n");
+   printf("I = hash index of the clusters ( write, match a reference disk )\n");
+   printf("U = rebuild the FAT by the directory ( contiguous files )\n");
+   printf("L = create FILEnnnn.CHK entries for the orphan chains\n");
+#ifdef BTEST
+   printf("B = benchmark FAT12 decoding and encoding, chain walks\n");
+#endif
    printf("**************************************************************************\n");
    c = getch();    /* ansi-c specific */
    c = toupper(c); /* for MSC, getch+toupper are not 
                       allowed in a single combined instruction ! */  
    switch (c)
     { case 'C' : { c = 10;break;};
+      case 'S' : { c = 11;break;};
+      case 'F' : { c = 13;break;};
+      case 'K' : { c = 14;break;};
+      case 'D' : { c = 15;break;};
+      case 'E' : { c = 16;break;};
+      case 'T' : { c = 17;break;};
+      case 'R' : { c = 18;break;};
+      case 'M' : { c = 19;break;};
+      case 'H' : { c = 20;break;};
+      case 'I' : { c = 21;break;};
+      case 'U' : { c = 22;break;};
+      case 'L' : { c = 23;break;};
+#ifdef BTEST
+      case 'B' : { c = 12;break;};
+#endif
       default  : {c = c - (int)'0'; break;};
     };
    return(c);
@@ -1726,9 +6749,188 @@ void main_menu()
              { errormessage(BOOTERR,FIRSTLOG);
              }
            else
-             { copy_fat(RESFAT,fatptr,btptr);};
+             { int n;
+               if ((n = copy_fat(RESFAT,fatptr,btptr)) >= 0)
+                { printf("%d sectors of FAT %d changed\n",n,RESFAT);
+                };
+             };
+           break;
+          };
+     case 11 : {if (!log_ok)
+             { errormessage(BOOTERR,FIRSTLOG);
+             }
+           else
+             { show_cache();};
+           break;
+          };
+     case 13 : {if (!log_ok)
+             { errormessage(BOOTERR,FIRSTLOG);
+             }
+           else
+             { show_freespace();};
+           break;
+          };
+     case 14 : {if (!log_ok)
+             { errormessage(BOOTERR,FIRSTLOG);
+             }
+           else
+             { xxx = setjmp(buffer);
+               if (xxx == 0)
+            { backhandle();
+              check_fat(fatptr,btptr,dirptr);
+              aborthandle();
+            }
+               else
+            { aborthandle();
+            };
+             };
+           break;
+          };
+     case 15 : {if (!log_ok)
+             { errormessage(BOOTERR,FIRSTLOG);
+             }
+           else
+             { xxx = setjmp(buffer);
+               if (xxx == 0)
+            { backhandle();
+              compare_fats(fatptr,btptr,dirptr);
+              aborthandle();
+            }
+               else
+            { aborthandle();
+            };
+             };
+           break;
+          };
+     case 16 : {if (!log_ok)
+             { errormessage(BOOTERR,FIRSTLOG);
+             }
+           else
+             { run_batch(fatptr,btptr,dirptr);};
+           break;
+          };
+     case 17 : {if (!log_ok)
+             { errormessage(BOOTERR,FIRSTLOG);
+             }
+           else
+             { xxx = setjmp(buffer);
+               if (xxx == 0)
+            { backhandle();
+              show_classes(btptr);
+              aborthandle();
+            }
+               else
+            { aborthandle();
+            };
+             };
+           break;
+          };
+     case 18 : {if (!log_ok)
+             { errormessage(BOOTERR,FIRSTLOG);
+             }
+           else
+             { xxx = setjmp(buffer);
+               if (xxx == 0)
+            { backhandle();
+              reassemble_text(FATLENGTH(btptr),(fatentry_tp *)fatptr,btptr,dirptr);
+              aborthandle();
+            }
+               else
+            { aborthandle();
+            };
+             };
+           break;
+          };
+     case 19 : {if (!log_ok)
+             { errormessage(BOOTERR,FIRSTLOG);
+             }
+           else
+             { xxx = setjmp(buffer);
+               if (xxx == 0)
+            { backhandle();
+              scan_patterns(btptr);
+              aborthandle();
+            }
+               else
+            { aborthandle();
+            };
+             };
+           break;
+          };
+     case 20 : {if (!log_ok)
+             { errormessage(BOOTERR,FIRSTLOG);
+             }
+           else
+             { xxx = setjmp(buffer);
+               if (xxx == 0)
+            { backhandle();
+              carve_menu(FATLENGTH(btptr),(fatentry_tp *)fatptr,btptr,dirptr);
+              aborthandle();
+            }
+               else
+            { aborthandle();
+            };
+             };
+           break;
+          };
+     case 21 : {if (!log_ok)
+             { errormessage(BOOTERR,FIRSTLOG);
+             }
+           else
+             { xxx = setjmp(buffer);
+               if (xxx == 0)
+            { backhandle();
+              hash_menu(FATLENGTH(btptr),(fatentry_tp *)fatptr,btptr,dirptr);
+              aborthandle();
+            }
+               else
+            { aborthandle();
+            };
+             };
+           break;
+          };
+     case 22 : {if (!log_ok)
+             { errormessage(BOOTERR,FIRSTLOG);
+             }
+           else
+             { xxx = setjmp(buffer);
+               if (xxx == 0)
+            { backhandle();
+              rebuild_fat(FATLENGTH(btptr),(fatentry_tp *)fatptr,btptr,dirptr);
+              aborthandle();
+            }
+               else
+            { aborthandle();
+            };
+             };
+           break;
+          };
+     case 23 : {if (!log_ok)
+             { errormessage(BOOTERR,FIRSTLOG);
+             }
+           else
+             { xxx = setjmp(buffer);
+               if (xxx == 0)
+            { backhandle();
+              make_chkfiles(FATLENGTH(btptr),(fatentry_tp *)fatptr,btptr,dirptr);
+              aborthandle();
+            }
+               else
+            { aborthandle();
+            };
+             };
+           break;
+          };
+#ifdef BTEST
+     case 12 : {if (!log_ok)
+             { errormessage(BOOTERR,FIRSTLOG);
+             }
+           else
+             { benchmark_fat12(fatptr,btptr);
+               benchmark_chains();};
            break;
           };
+#endif
 
      default: {break;}
        };
@@ -65,6 +65,46 @@ extern void strupr(char *);
 
 #endif
 
+/* Raw disk image files instead of MSDOS drives, with a Unix host */
+#ifdef __unix__
+/**
+ *  @def      IMGDISK
+ *  @brief    With a Unix host, there are no MSDOS drives,
+ *            so always the raw disk image files are edited
+ */
+#define IMGDISK
+
+/**
+ *  @def      _osmajor
+ *  @brief    Dummy value for the major operating system version
+ */
+#define _osmajor 0
+/**
+ *  @def      _osminor
+ *  @brief    Dummy value for the minor operating system version
+ */
+#define _osminor 0
+
+extern int getch(void);
+extern void strupr(char *);
+
+#endif
+
+#ifdef __unix__
+/**
+ *  @typedef  sector_tp
+ *  @brief    Logical sector number, with a Unix host "long",
+ *            for FAT32 volumes of more than 2^31 sectors
+ */
+typedef long sector_tp;
+#else
+/**
+ *  @typedef  sector_tp
+ *  @brief    Logical sector number, like "absread" of MSDOS
+ */
+typedef int sector_tp;
+#endif
+
 #include <stdlib.h>
 #ifdef _DOS_MODE
 /* _DOS_MODE is just defined for MSC, MSVCPP */
@@ -127,12 +167,37 @@ extern void strupr(char *);
  */
 #undef RTEST
 
-/** 
+/**
+ *   def      IMGDISK
+ *  @brief    If defined, then the drives are raw disk image files
+ *            ( see absimage.c ) instead of MSDOS drives.
+ *            With a Unix host, it is always defined
+ */
+#ifndef __unix__
+#undef IMGDISK
+#endif
+
+/**
  *   def      FTEST
  *  @brief    If defined, then the FAT entry number is displayed
  */
 #define FTEST
 
+/** 
+ *   def      FATSHADOW
+ *  @brief    If defined, then the work FAT is decoded once at login,
+ *            and just the modified entries are entered into the FAT 
+ *            at write back
+ */
+#define FATSHADOW
+
+/** 
+ *   def      BTEST
+ *  @brief    If defined, then the main menu offers a benchmark of
+ *            the FAT12 decoding and encoding
+ */
+#undef BTEST
+
 /** 
  *   def      TEST1
  *  @brief    Just for testing, to do additional output
@@ -191,13 +256,18 @@ extern void strupr(char *);
 #include <string.h>
 
 #ifndef __TI_COMPILER_VERSION__
+#ifndef __unix__
 #include <process.h>
 #include <dos.h>
 #include <conio.h>
 #endif
+#endif
 
 #include <signal.h>
 #include <setjmp.h>
+#ifdef BTEST
+#include <time.h>
+#endif
           
 #ifdef MSVCPP
 /** 
@@ -323,18 +393,63 @@ extern void strupr(char *);
 #endif
 
 /** 
- *  @fn       absread (int drive, int nsects, int lsect, void *buffer)
+ *  @fn       absread (int drive, int nsects, sector_tp lsect, void *buffer)
  *  @brief    Specification of the external function "absread".
  *            This function is missing in the Microsoft C libraries
  */
-int absread (int drive, int nsects, int lsect, void *buffer);
+int absread (int drive, int nsects, sector_tp lsect, void *buffer);
 
 /** 
- *  @fn       abswrite (int drive, int nsects, int lsect, void *buffer)
+ *  @fn       abswrite (int drive, int nsects, sector_tp lsect, void *buffer)
  *  @brief    Specification of the external function "abswrite".
  *            This function is missing in the Microsoft C libraries
  */
-int abswrite(int drive, int nsects, int lsect, void *buffer);
+int abswrite(int drive, int nsects, sector_tp lsect, void *buffer);
+#endif
+
+#ifdef IMGDISK
+/** 
+ *  @fn       absopen (int drive, char *filename)
+ *  @brief    Assign a raw disk image file to a drive ( a=0, b=1, etc ),
+ *            so "absread" and "abswrite" access this image file
+ */
+int absopen (int drive, char *filename);
+
+/** 
+ *  @fn       absclose (int drive)
+ *  @brief    Release the raw disk image file of a drive
+ */
+void absclose (int drive);
+
+/** 
+ *  @fn       absmap (int drive, int nsects, sector_tp lsect)
+ *  @brief    Pointer to the sectors within the memory mapping 
+ *            of the raw disk image file,
+ *            NULL if they can't be mapped ( then use "absread" )
+ */
+void *absmap (int drive, int nsects, sector_tp lsect);
+
+#ifndef MSC
+/** 
+ *  @fn       absread (int drive, int nsects, sector_tp lsect, void *buffer)
+ *  @brief    Read sectors of the raw disk image file
+ */
+int absread (int drive, int nsects, sector_tp lsect, void *buffer);
+
+/** 
+ *  @fn       abswrite (int drive, int nsects, sector_tp lsect, void *buffer)
+ *  @brief    Write sectors of the raw disk image file
+ */
+int abswrite(int drive, int nsects, sector_tp lsect, void *buffer);
+#endif
+
+/**
+ *  @fn       get_image(int)
+ *  @param    drive
+ *  @return   struct image_tp *
+ *	@brief    Image file of the drive, NULL if there is none
+ */
+struct image_tp *get_image(int);
 #endif
 
 #ifdef MSC_MIXPC
@@ -411,11 +526,21 @@ typedef void * FAR_PTR;
  */
 #define FAT12B 12
 
+/** 
+ *  @def      FAT32B
+ *  @brief    The FAT is of type FAT32, with 28-bit entries.
+ *
+ *  Just with a Unix host, as a 16-bit "int" can't hold a cluster number
+ */
+#define FAT32B 32
+
 /** 
  *  @def      ERRCLUST
- *  @brief    Error cluster return value ( it is a reserved cluster value )
+ *  @brief    Error cluster return value, 0xFFF6 with a 16-bit "int"
+ *            ( a reserved cluster value ), else above every 28-bit
+ *            FAT32 value
  */
-#define ERRCLUST 0xFFF6
+#define ERRCLUST ((unsigned int)~9U)
 
 /** 
  *  @def      RESCLUST
@@ -423,6 +548,25 @@ typedef void * FAR_PTR;
  */
 #define RESCLUST 0xFFF0
 
+/** 
+ *  @def      RESCLUST12
+ *  @brief    First reserved cluster value of a 12-bit FAT
+ */
+#define RESCLUST12 0xFF0
+
+/** 
+ *  @def      RESCLUST32
+ *  @brief    First reserved cluster value of a 32-bit FAT
+ */
+#define RESCLUST32 0x0FFFFFF0L
+
+/** 
+ *  @def      FAT32MASK
+ *  @brief    The 28 bits of an entry of a 32-bit FAT,
+ *            the upper 4 bits are reserved
+ */
+#define FAT32MASK 0x0FFFFFFFL
+
 /** 
  *  @def      EOFAT
  *  @brief    Last value of a FAT link
@@ -573,6 +717,150 @@ typedef void * FAR_PTR;
  */
 #define FATLOOP     14
 
+/** 
+ *  @def      IMGERR
+ *  @brief    IMGERR
+ */
+#define IMGERR      15
+
+/** 
+ *  @def      SWRITEERR
+ *  @brief    SWRITEERR
+ */
+#define SWRITEERR   16
+
+/** 
+ *  @def      CACHEERR
+ *  @brief    CACHEERR
+ */
+#define CACHEERR    17
+
+/** 
+ *  @def      FREEERR
+ *  @brief    FREEERR
+ */
+#define FREEERR     18
+
+/** 
+ *  @def      NOOWNERERR
+ *  @brief    NOOWNERERR
+ */
+#define NOOWNERERR  19
+
+/** 
+ *  @def      BATCHERR
+ *  @brief    BATCHERR
+ */
+#define BATCHERR    20
+
+/** 
+ *  @def      SCRIPTERR
+ *  @brief    SCRIPTERR
+ */
+#define SCRIPTERR   21
+
+/** 
+ *  @def      NOCLASSERR
+ *  @brief    NOCLASSERR
+ */
+#define NOCLASSERR  22
+
+/** 
+ *  @def      NOTEXTERR
+ *  @brief    NOTEXTERR
+ */
+#define NOTEXTERR   23
+
+/** 
+ *  @def      NOSUGGESTERR
+ *  @brief    NOSUGGESTERR
+ */
+#define NOSUGGESTERR 24
+
+/** 
+ *  @def      ROOTFULLERR
+ *  @brief    ROOTFULLERR
+ */
+#define ROOTFULLERR 25
+
+/** 
+ *  @def      NOORPHANERR
+ *  @brief    NOORPHANERR
+ */
+#define NOORPHANERR 26
+
+/** 
+ *  @def      PATTERNERR
+ *  @brief    PATTERNERR
+ */
+#define PATTERNERR  27
+
+/** 
+ *  @def      NOTFOUNDERR
+ *  @brief    NOTFOUNDERR
+ */
+#define NOTFOUNDERR 28
+
+/** 
+ *  @def      PATFILEERR
+ *  @brief    PATFILEERR
+ */
+#define PATFILEERR  29
+
+/** 
+ *  @def      PATCOUNTERR
+ *  @brief    PATCOUNTERR
+ */
+#define PATCOUNTERR 30
+
+/** 
+ *  @def      CARVEERR
+ *  @brief    CARVEERR
+ */
+#define CARVEERR    31
+
+/** 
+ *  @def      HASHFILEERR
+ *  @brief    HASHFILEERR
+ */
+#define HASHFILEERR 32
+
+/** 
+ *  @def      HASHSIZEERR
+ *  @brief    HASHSIZEERR
+ */
+#define HASHSIZEERR 33
+
+/** 
+ *  @def      SUBFREEERR
+ *  @brief    SUBFREEERR
+ */
+#define SUBFREEERR  34
+
+/** 
+ *  @def      SUBWRITEERR
+ *  @brief    SUBWRITEERR
+ */
+#define SUBWRITEERR 35
+
+/** 
+ *  @def      DIRTREEERR
+ *  @brief    DIRTREEERR
+ */
+#define DIRTREEERR  36
+
+/** 
+ *  @def      NOSUBDIRERR
+ *  @brief    NOSUBDIRERR
+ */
+#define NOSUBDIRERR 37
+
+/** 
+ *  @def      NONAMEERR
+ *  @brief    NONAMEERR
+ */
+#define NONAMEERR   38
+
 /* Some different fatal errors */
 
 /** 
@@ -693,491 +981,2335 @@ typedef void * FAR_PTR;
  */
 #define SEC 5
 
-/* Structure types */
+/** 
+ *  @def      MAXDRIVES
+ *  @brief    Number of drive letters <A:>...<Z:>
+ */
+#define MAXDRIVES 26
 
 /** 
- *  @struct   bootinfo_tp
- *  @brief    Structure of the bootsector infoblock
+ *  @def      IMGNAMELEN
+ *  @brief    Maximum length of the filename of a disk image file
  */
-struct bootinfo_tp
- { 
-   /*@{*/
-   char jmpcode; /**< jmpcode */
-   int  nearjmp; /**< nearjmp */
-   char oemname[NLENGTH]; /**< OEM name */
-   unsigned int  bytes_per_sector; /**< bytes per sector */
-   unsigned char sectors_per_cluster; /**< sectors per cluster */ 
-   unsigned int  reserved_sectors; /**< reserved sectors */
-   unsigned char number_of_fats; /**< number of FATs */ 
-   unsigned int  number_of_direntries; /**< number of direntries */
-   unsigned int  number_of_sectors; /**< number of sectors */
-   unsigned char media_flag; /**< media flag */
-   unsigned int  sectors_per_fat; /**< sectors per FAT */
-   unsigned int  sectors_per_track; /**< sectors per track */
-   unsigned int  number_of_heads; /**< number of heads */
-   unsigned int  number_of_hiddensectors; /**< number of hiddensectors */
-   /*@}*/
- };
+#define IMGNAMELEN 80
 
 /** 
- *  @struct   direntry_tp
- *  @brief    Structure of a 32-byte directory entry
+ *  @def      CACHEBUDGET
+ *  @brief    Default memory budget of the sector cache in bytes
  */
-struct direntry_tp
-  { 
-    /*@{*/
-    unsigned char filename[NLENGTH]; /**< filename */
-    unsigned char extension[ELENGTH]; /**< extension */
-    unsigned char attribute; /**< attribute */
-    unsigned char reserved[10]; /**< reserved */
-    unsigned int second : SEC; /**< second */
-    unsigned int minute : MNU; /**< minute */
-    unsigned int hour : HOR; /**< hour */
-    unsigned int day :DAY; /**< day */
-    unsigned int month : MON; /**< month */
-    unsigned int year : YER; /**< year */
-    unsigned int startcluster; /**< startcluster */
-    unsigned long filelength; /**< filelength */
-   /*@}*/
-  };
+#define CACHEBUDGET 16384L
 
 /** 
- *  @typedef  bootsec_tp
- *  @brief    Type definition of a bootsector
+ *  @def      FATBUDGET
+ *  @brief    Largest FAT area in bytes, which is read into memory at once,
+ *            larger FATs are paged
  */
-typedef struct bootinfo_tp bootsec_tp;
+#define FATBUDGET 65520L
 
 /** 
- *   typedef  fatsec_tp
- *  @brief    Type definition of a FAT sector
- *            ( QC doesn't like typedef here )
+ *  @def      FATWINDOW
+ *  @brief    Number of FAT sectors, which are read together by a paged FAT
  */
-#define fatsec_tp void
+#define FATWINDOW 8
 
-#ifdef  DOXYGEN
 /** 
- *  @struct   dfatentry12_struct
- *  @brief    Structure definition of a double FAT entry for 12-bit FAT
+ *  @def      BENCHLOOPS
+ *  @brief    Number of passes over the FAT of each benchmark
  */
-struct dfatentry12_struct 
-{ 
-  /*@{*/
-  unsigned char x [3]; /**< x */
-  /*@}*/
-};
+#define BENCHLOOPS 200
 
 /** 
- *  @typedef  dfatentry12_tp
- *  @brief    Type definition of a double FAT entry for 12-bit FAT
+ *  @def      FATBLOCK
+ *  @brief    Number of FAT entries, which are decoded together
  */
-typedef struct dfatentry12_struct dfatentry12_tp;
-#else
+#define FATBLOCK 64
+
 /** 
- *  @typedef  dfatentry12_tp
- *  @brief    Type definition of a double FAT entry for 12-bit FAT
+ *  @def      EDITFAT
+ *  @brief    Edit of a FAT entry by an edit script
  */
-typedef struct 
-{ 
-  /*@{*/
-  unsigned char x [3]; /**< x */
-  /*@}*/
-} dfatentry12_tp;
-#endif
+#define EDITFAT 0
 
 /** 
- *  @typedef  fatentry16_tp
- *  @brief    Type definition of a FAT entry for 16-bit FAT
+ *  @def      EDITDIR
+ *  @brief    Edit of a directory entry by an edit script
  */
-typedef int fatentry16_tp;
+#define EDITDIR 1
 
 /** 
- *  @typedef  fatentry_tp
- *  @brief    More simple type definition of a FAT entry in general,
- *            of course for fatentry16_tp 
- *            there would be a type adaption necessary
+ *  @def      FLDNAME
+ *  @brief    Directory entry field "filename" of an edit script,
+ *            FLDEXT, FLDATTR, FLDSTART and FLDLENGTH are the others
  */
-typedef dfatentry12_tp fatentry_tp;
+#define FLDNAME   0
+#define FLDEXT    1
+#define FLDATTR   2
+#define FLDSTART  3
+#define FLDLENGTH 4
 
+/** 
+ *  @def      BATCHCHUNK
+ *  @brief    Number of edits, for which memory is allocated together
+ */
+#define BATCHCHUNK 256
 
-/* Function declarations */
+/** 
+ *  @def      LINELEN
+ *  @brief    Maximum length of a line of an edit script
+ */
+#define LINELEN 128
 
-/**
- *  @fn       errormessage(int,int)
- *  @param    errtyp4
- *  @param    error4
- *	@brief    General error message 
+/** 
+ *  @def      CLUNKNOWN
+ *  @brief    Class of the contents of a cluster: not classified or
+ *            not readable. CLZERO = zeros, CLF6 = formatted, 
+ *            CLTEXT = text, CLBINARY = other data
  */
-void errormessage(int,int);
+#define CLUNKNOWN 0
+#define CLZERO    1
+#define CLF6      2
+#define CLTEXT    3
+#define CLBINARY  4
 
-/**
- *  @fn       clustosec(int,bootsec_tp *)
- *  @param    cluster
- *  @param    btptr2
- *  @return   int
- *	@brief    Conversion cluster -> sector 
+/** 
+ *  @def      CLASSES
+ *  @brief    Number of classes of the contents of a cluster
  */
-int clustosec(int,bootsec_tp *);
+#define CLASSES 5
 
-/**
- *  @fn       sectoclus(int,bootsec_tp *)
- *  @param    sector
- *  @param    btptr2
- *  @return   int
- *	@brief    Conversion sector -> cluster 
+/** 
+ *  @def      CLASSCHUNK
+ *  @brief    Number of sectors, which are classified together
  */
-int sectoclus(int,bootsec_tp *);
+#define CLASSCHUNK 64
 
-/**
- *  @fn       copy_fat(int,fatsec_tp *,bootsec_tp *);
- *  @param    fatnumber - nth FAT, which is the destionation FAT
- *  @param    fatptr2
- *  @param    btptr2
- *	@brief    Conversion from first to nth FAT 
+/** 
+ *  @def      SUGGESTK
+ *  @brief    Number of suggested next clusters of a text cluster
  */
-void copy_fat(int,fatsec_tp *,bootsec_tp *);
+#define SUGGESTK 4
 
-/**
- *  @fn       get_fatentry12(unsigned int,int,int,dfatentry12_tp *)
- *  @param    index
- *  @param    fatlength
- *  @param    fatnumber
- *  @param    fatptr2
- *  @return   unsigned int
- *	@brief    Calculate the 12-bit FAT entry, error = ERRCLUST 
+/** 
+ *  @def      SUGGESTNEAR
+ *  @brief    The following text clusters up to this distance are always
+ *            scored, they get points by the allocation order
  */
-unsigned int get_fatentry12(unsigned int,int,int,dfatentry12_tp *);
+#define SUGGESTNEAR 32
 
-/**
- *  @fn       put_fatentry12(unsigned int,unsigned int,int,int,
-                             dfatentry12_tp *)
- *  @param    value
- *  @param    index
- *  @param    fatlength of one FAT in number of sectors 
- *  @param    fatnumber
- *  @param    fatptr2
- *  @return   unsigned int
+/** 
+ *  @def      SUGGESTSCAN
+ *  @brief    Maximum number of further text clusters, which are scored
+ *            for the suggestions of a text cluster
+ */
+#define SUGGESTSCAN 1024
+
+/** 
+ *  @def      SUGGESTREST
+ *  @brief    Most points of "text_score", which don't depend on the
+ *            first byte of the next cluster
+ */
+#define SUGGESTREST 12
+
+/** 
+ *  @def      REASSEMBLEK
+ *  @brief    Number of the best next clusters of an orphaned text cluster,
+ *            which are tried by the reassembly
+ */
+#define REASSEMBLEK 8
+
+/** 
+ *  @def      GRAMSIZE
+ *  @brief    Size of the table of the hashed triples of bytes
+ */
+#define GRAMSIZE 16384
+
+/** 
+ *  @def      GRAMHASH(a,b,c)
+ *  @brief    Hash of a triple of bytes
+ */
+#define GRAMHASH(a,b,c) (((unsigned int)(a) * 961 + (unsigned int)(b) * 31 + \
+                          (unsigned int)(c)) & (GRAMSIZE - 1))
+
+/** 
+ *  @def      SEARCHMAX
+ *  @brief    Maximum length of a search pattern
+ */
+#define SEARCHMAX 64
+
+/** 
+ *  @def      SEARCHHITS
+ *  @brief    Maximum number of shown hits of a search
+ */
+#define SEARCHHITS 32
+
+/** 
+ *  @def      SEARCHBUFSIZE
+ *  @brief    Size of a read of whole clusters of a search
+ */
+#define SEARCHBUFSIZE 32768U
+
+/** 
+ *  @def      ACPATTERNS
+ *  @brief    Maximum number of patterns of a pattern file
+ */
+#define ACPATTERNS 64
+
+/** 
+ *  @def      ACNODES
+ *  @brief    Maximum number of nodes of the Aho-Corasick automaton
+ */
+#define ACNODES 4096
+
+/** 
+ *  @def      CARVESIGS
+ *  @brief    Number of the headers of binary files of "carvesigs"
+ */
+#define CARVESIGS 6
+
+/** 
+ *  @def      CARVEHITS
+ *  @brief    Maximum number of files found by carving
+ */
+#define CARVEHITS 256
+
+/** 
+ *  @def      CARVEMAX
+ *  @brief    Maximum length of a carved file, in clusters
+ */
+#define CARVEMAX 4096U
+
+/** 
+ *  @def      CVEXE
+ *  @brief    Kinds of the headers of binary files,
+ *            how the filelength is estimated
+ */
+#define CVEXE  0
+#define CVZIP  1
+#define CVARC  2
+#define CVGIF  3
+#define CVBMP  4
+#define CVJPEG 5
+
+/** 
+ *  @def      ROOTOWNER
+ *  @brief    Owner of the clusters of the main directory of FAT32,
+ *            with the FAT rebuild
+ */
+#define ROOTOWNER ((unsigned int)~0)
+
+/** 
+ *  @def      KEEPOWNER
+ *  @brief    Owner of the bad clusters and of the clusters of the
+ *            subdirectories, which are kept with the FAT rebuild
+ */
+#define KEEPOWNER ((unsigned int)~1)
+
+/** 
+ *  @def      HASHMAGIC
+ *  @brief    First bytes of a hash index file
+ */
+#define HASHMAGIC "FEHX"
+
+/** 
+ *  @def      DIRNODES
+ *  @brief    The directory tree grows by this number of nodes
+ */
+#define DIRNODES 64
+
+/** 
+ *  @def      DIRBUFMAX
+ *  @brief    Maximum length of a subdirectory in memory, in bytes
+ *            ( a single allocation of the Large Model )
+ */
+#define DIRBUFMAX 65024U
+
+/** 
+ *  @def      MAINNODE
+ *  @brief    Node of the main directory within the directory tree
+ */
+#define MAINNODE 0
+
+/** 
+ *  @def      DIRFILE(d)
+ *  @brief    The direntry is a file or a subdirectory with a startcluster
+ */
+#define DIRFILE(d) (((d)->filename[0] != 0x00) && ((d)->filename[0] != 0xE5) && \
+                    (((d)->attribute & 0x08) == 0) && ISCLUSTER(STARTCLUSTER(d)))
+
+/** 
+ *  @def      GETCLASS(cl)
+ *  @brief    Class of a cluster within "classmap"
+ */
+#define GETCLASS(cl) ((classmap[(cl) >> 1] >> (((cl) & 1) << 2)) & 0x0F)
+
+/** 
+ *  @def      SETCLASS(cl,c)
+ *  @brief    Set the class of a cluster within "classmap"
+ */
+#define SETCLASS(cl,c) (classmap[(cl) >> 1] = (unsigned char) \
+   ((classmap[(cl) >> 1] & (0xF0 >> (((cl) & 1) << 2))) | ((c) << (((cl) & 1) << 2))))
+
+/** 
+ *  @def      FREEBITS
+ *  @brief    Number of clusters per word of the free cluster bitmap
+ */
+#define FREEBITS 16
+
+/** 
+ *  @def      NOOWNER
+ *  @brief    Cluster without owner directory entry
+ */
+#define NOOWNER -1
+
+/** 
+ *  @def      ISCLUSTER
+ *  @brief    "true", if "cl" is a cluster of the data area
+ */
+#define ISCLUSTER(cl) (((unsigned int)(cl) >= 2) && \
+                       ((unsigned int)(cl) < (unsigned int)clusters))
+
+/** 
+ *  @def      FATENTRY12(p,i)
+ *  @brief    Entry "i" of a 12-bit FAT, "p" points to its first byte
+ */
+#define FATENTRY12(p,i) (((i) & 1) ? \
+   (((unsigned int)(p)[((i) >> 1) * 3 + 1] >> 4) + \
+    ((unsigned int)(p)[((i) >> 1) * 3 + 2] << 4)) : \
+   ((unsigned int)(p)[((i) >> 1) * 3] + \
+    (((unsigned int)(p)[((i) >> 1) * 3 + 1] & 0x0F) << 8)))
+
+/** 
+ *  @def      FATENTRY16(p,i)
+ *  @brief    Entry "i" of a 16-bit FAT, "p" points to its first byte
+ */
+#define FATENTRY16(p,i) ((unsigned int)*((fatentry16_tp *)(p) + (i)))
+
+/** 
+ *  @def      FATENTRY32(p,i)
+ *  @brief    Entry "i" of a 32-bit FAT, "p" points to its first byte
+ */
+#define FATENTRY32(p,i) ((unsigned int)(*((fatentry32_tp *)(p) + (i)) & FAT32MASK))
+
+/** 
+ *  @def      BITMAPSIZE(n)
+ *  @brief    Number of bytes of a bitmap with n bits
+ */
+#define BITMAPSIZE(n) (((n) + 7) >> 3)
+
+/** 
+ *  @def      SETBIT(map,i)
+ *  @brief    Set bit i of a bitmap
+ */
+#define SETBIT(map,i) ((map)[(i) >> 3] |= (unsigned char)(1 << ((i) & 7)))
+
+/** 
+ *  @def      CLRBIT(map,i)
+ *  @brief    Clear bit i of a bitmap
+ */
+#define CLRBIT(map,i) ((map)[(i) >> 3] &= (unsigned char)~(1 << ((i) & 7)))
+
+/** 
+ *  @def      TESTBIT(map,i)
+ *  @brief    Test bit i of a bitmap
+ */
+#define TESTBIT(map,i) ((map)[(i) >> 3] & (1 << ((i) & 7)))
+
+/** 
+ *  @def      FATLENGTH(bt)
+ *  @brief    Sectors per FAT, 16-bit or FAT32 value of the bootsector
+ */
+#define FATLENGTH(bt) ((bt)->sectors_per_fat ? (int)(bt)->sectors_per_fat : \
+                       (int)(bt)->sectors_per_fat32)
+
+/** 
+ *  @def      TOTALSECS(bt)
+ *  @brief    Number of sectors, 16-bit or 32-bit value of the bootsector
+ */
+#define TOTALSECS(bt) ((bt)->number_of_sectors ? \
+                       (sector_tp)(bt)->number_of_sectors : \
+                       (sector_tp)(bt)->number_of_sectors32)
+
+/** 
+ *  @def      DIRENTRIES(bt)
+ *  @brief    Number of entries of the main directory,
+ *            with FAT32 by the length of its cluster chain
+ */
+#define DIRENTRIES(bt) ((bt)->number_of_direntries ? \
+                        (int)(bt)->number_of_direntries : rootentries)
+
+/** 
+ *  @def      STARTCLUSTER(d)
+ *  @brief    Startcluster of a directory entry, 
+ *            with FAT32 including the upper word
+ */
+#define STARTCLUSTER(d) ((fattyp == FAT32B) ? \
+   (unsigned int)((d)->startcluster + ((unsigned long)(d)->startcluster_high << 16)) : \
+   (unsigned int)(d)->startcluster)
+
+/* Types of the 16-bit and 32-bit values on the disk */
+
+#ifdef __unix__
+/** 
+ *  @typedef  word_tp
+ *  @brief    16-bit value on the disk, 
+ *            with a Unix host "int" is 32-bit
+ */
+typedef unsigned short word_tp;
+
+/** 
+ *  @typedef  dword_tp
+ *  @brief    32-bit value on the disk, 
+ *            with a Unix host "long" may be 64-bit
+ */
+typedef unsigned int dword_tp;
+
+/* the structures must match the disk byte by byte */
+#pragma pack(1)
+#else
+/** 
+ *  @typedef  word_tp
+ *  @brief    16-bit value on the disk
+ */
+typedef unsigned int word_tp;
+
+/** 
+ *  @typedef  dword_tp
+ *  @brief    32-bit value on the disk
+ */
+typedef unsigned long dword_tp;
+#endif
+
+/* Structure types */
+
+/** 
+ *  @struct   bootinfo_tp
+ *  @brief    Structure of the bootsector infoblock
+ */
+struct bootinfo_tp
+ { 
+   /*@{*/
+   char jmpcode; /**< jmpcode */
+   word_tp nearjmp; /**< nearjmp */
+   char oemname[NLENGTH]; /**< OEM name */
+   word_tp bytes_per_sector; /**< bytes per sector */
+   unsigned char sectors_per_cluster; /**< sectors per cluster */ 
+   word_tp reserved_sectors; /**< reserved sectors */
+   unsigned char number_of_fats; /**< number of FATs */ 
+   word_tp number_of_direntries; /**< number of direntries */
+   word_tp number_of_sectors; /**< number of sectors */
+   unsigned char media_flag; /**< media flag */
+   word_tp sectors_per_fat; /**< sectors per FAT */
+   word_tp sectors_per_track; /**< sectors per track */
+   word_tp number_of_heads; /**< number of heads */
+   word_tp number_of_hiddensectors; /**< number of hiddensectors */
+   word_tp hiddensectors_high; /**< number of hiddensectors, upper word */
+   dword_tp number_of_sectors32; /**< number of sectors, if "number_of_sectors" is 0 */
+   /* FAT32 only */
+   dword_tp sectors_per_fat32; /**< sectors per FAT, if "sectors_per_fat" is 0 */
+   word_tp ext_flags; /**< active FAT, mirroring */
+   word_tp fs_version; /**< file system version */
+   dword_tp root_cluster; /**< first cluster of the root directory */
+   word_tp fsinfo_sector; /**< sector of the FSINFO structure */
+   word_tp backup_bootsector; /**< sector of the backup bootsector */
+   /*@}*/
+ };
+
+/** 
+ *  @struct   direntry_tp
+ *  @brief    Structure of a 32-byte directory entry
+ */
+struct direntry_tp
+  { 
+    /*@{*/
+    unsigned char filename[NLENGTH]; /**< filename */
+    unsigned char extension[ELENGTH]; /**< extension */
+    unsigned char attribute; /**< attribute */
+    unsigned char reserved[8]; /**< reserved */
+    word_tp startcluster_high; /**< startcluster, upper word with FAT32 */
+    word_tp second : SEC; /**< second */
+    word_tp minute : MNU; /**< minute */
+    word_tp hour : HOR; /**< hour */
+    word_tp day :DAY; /**< day */
+    word_tp month : MON; /**< month */
+    word_tp year : YER; /**< year */
+    word_tp startcluster; /**< startcluster */
+    dword_tp filelength; /**< filelength */
+   /*@}*/
+  };
+
+#ifdef IMGDISK
+/** 
+ *  @struct   image_tp
+ *  @brief    Structure of a raw disk image file, assigned to a drive letter
+ *
+ *  With a Unix host, the image file is mapped into memory 
+ *  as private ( copy-on-write ) mapping, so the FATs and the directory 
+ *  are edited directly within the mapping, and just "abswrite" 
+ *  writes them back to the image file
+ */
+struct image_tp
+ { 
+   /*@{*/
+   char name[IMGNAMELEN]; /**< filename of the image file */
+   unsigned int secsize; /**< bytes per sector, from the bootsector */
+   long size; /**< size of the image file in bytes */
+#ifdef __unix__
+   int fd; /**< file descriptor */
+   unsigned char *base; /**< start of the memory mapping */
+#else
+   FILE *fp; /**< file pointer */
+#endif
+   /*@}*/
+ };
+#endif
+
+/** 
+ *  @struct   cacheslot_tp
+ *  @brief    Structure of a slot of the sector cache
+ */
+struct cacheslot_tp
+ { 
+   /*@{*/
+   sector_tp lsect; /**< logical sector, -1 = slot is unused */
+   int dirty; /**< sector is modified, but not written back */
+   int prev; /**< previous ( more recently used ) slot */
+   int next; /**< next ( less recently used ) slot */
+   int hnext; /**< next slot with the same hash value */
+   /*@}*/
+ };
+
+/** 
+ *  @struct   batchedit_tp
+ *  @brief    Structure of an edit of an edit script
+ */
+struct batchedit_tp
+ { 
+   /*@{*/
+   int kind; /**< EDITFAT or EDITDIR */
+   int field; /**< field of the directory entry, FLDNAME... */
+   int line; /**< line of the edit script */
+   unsigned long index; /**< FAT entry or directory entry */
+   unsigned long value; /**< new value */
+   char text[NLENGTH + 1]; /**< new filename or extension */
+   /*@}*/
+ };
+
+/** 
+ *  @struct   textinfo_tp
+ *  @brief    Features of the start and the end of a text cluster
+ */
+struct textinfo_tp
+ { 
+   /*@{*/
+   unsigned int cluster; /**< cluster */
+   unsigned int headline; /**< length of the first line */
+   unsigned int tailline; /**< length of the last, unfinished line */
+   unsigned int avgline; /**< average length of the lines */
+   unsigned int length; /**< number of bytes before the zeros at the end */
+   unsigned char first; /**< first byte */
+   unsigned char second; /**< second byte */
+   unsigned char last; /**< last byte, before the zeros at the end */
+   unsigned char prelast; /**< byte before the last byte */
+   unsigned char headindent; /**< indentation of the first whole line */
+   unsigned char tailindent; /**< indentation of the last line */
+   unsigned char headword; /**< length of the part of a word at the start */
+   unsigned char tailword; /**< length of the part of a word at the end */
+   unsigned char full; /**< no zeros at the end, the file goes on */
+   unsigned char code; /**< C source, by braces and semicolons */
+   /*@}*/
+ };
+
+/** 
+ *  @struct   acnode_tp
+ *  @brief    Node of the Aho-Corasick automaton, a byte of a pattern
+ */
+struct acnode_tp
+ { 
+   /*@{*/
+   unsigned int child; /**< first next node, 0 = none */
+   unsigned int sibling; /**< next node with the same parent, 0 = none */
+   unsigned int fail; /**< node of the longest suffix, if no next node fits */
+   unsigned int dict; /**< next node with a pattern on the way of "fail" */
+   int pattern; /**< number of the pattern ending here, -1 = none */
+   unsigned char byte; /**< byte */
+   /*@}*/
+ };
+
+/** 
+ *  @struct   acauto_tp
+ *  @brief    Aho-Corasick automaton of the patterns of a pattern file
+ */
+struct acauto_tp
+ { 
+   /*@{*/
+   struct acnode_tp *node; /**< nodes, node 0 is the root */
+   unsigned int nnodes; /**< number of nodes */
+   unsigned int root[256]; /**< next node of the root for each byte */
+   int npatterns; /**< number of patterns */
+   char name[ACPATTERNS][LINELEN]; /**< the patterns, as written in the file */
+   /*@}*/
+ };
+
+/** 
+ *  @struct   carvesig_tp
+ *  @brief    Header of a kind of binary files
+ */
+struct carvesig_tp
+ { 
+   /*@{*/
+   char *name; /**< name of the kind */
+   char *ext; /**< extension of a new direntry */
+   unsigned char magic[4]; /**< first bytes of the file */
+   int len; /**< number of the first bytes */
+   int kind; /**< CVEXE...CVJPEG */
+   /*@}*/
+ };
+
+/** 
+ *  @struct   carvecand_tp
+ *  @brief    Binary file found by carving
+ */
+struct carvecand_tp
+ { 
+   /*@{*/
+   unsigned int cluster; /**< startcluster */
+   int sig; /**< header of "carvesigs" */
+   long length; /**< estimated filelength, 0 = unknown */
+   /*@}*/
+ };
+
+/** 
+ *  @struct   carveread_tp
+ *  @brief    Reading of a contiguous file, cluster by cluster
+ */
+struct carveread_tp
+ { 
+   /*@{*/
+   unsigned int first; /**< startcluster */
+   unsigned int cl; /**< cluster of "data" */
+   unsigned int csize; /**< bytes per cluster */
+   unsigned char *data; /**< data of cluster "cl" */
+   unsigned char *buffer; /**< buffer of one cluster */
+   struct bootinfo_tp *bt; /**< bootsector */
+   /*@}*/
+ };
+
+/** 
+ *  @struct   dirnode_tp
+ *  @brief    Directory of the directory tree
+ */
+struct dirnode_tp
+ { 
+   /*@{*/
+   unsigned int start; /**< startcluster, 0 for the main directory */
+   int parent; /**< node of the parent directory, -1 for the main directory */
+   int depth; /**< number of parent directories */
+   unsigned int entries; /**< number of direntries of "dir" */
+   unsigned int nclusters; /**< number of clusters of "dir" */
+   int truncated; /**< the chain is longer than DIRBUFMAX */
+   int dirty; /**< "dir" is modified, but not yet written back */
+   char name[NLENGTH + ELENGTH + 2]; /**< name of the subdirectory */
+   struct direntry_tp *dir; /**< the direntries, NULL for the main directory */
+   /*@}*/
+ };
+
+/** 
+ *  @typedef  bootsec_tp
+ *  @brief    Type definition of a bootsector
+ */
+typedef struct bootinfo_tp bootsec_tp;
+
+/** 
+ *   typedef  fatsec_tp
+ *  @brief    Type definition of a FAT sector
+ *            ( QC doesn't like typedef here )
+ */
+#define fatsec_tp void
+
+#ifdef  DOXYGEN
+/** 
+ *  @struct   dfatentry12_struct
+ *  @brief    Structure definition of a double FAT entry for 12-bit FAT
+ */
+struct dfatentry12_struct 
+{ 
+  /*@{*/
+  unsigned char x [3]; /**< x */
+  /*@}*/
+};
+
+/** 
+ *  @typedef  dfatentry12_tp
+ *  @brief    Type definition of a double FAT entry for 12-bit FAT
+ */
+typedef struct dfatentry12_struct dfatentry12_tp;
+#else
+/** 
+ *  @typedef  dfatentry12_tp
+ *  @brief    Type definition of a double FAT entry for 12-bit FAT
+ */
+typedef struct 
+{ 
+  /*@{*/
+  unsigned char x [3]; /**< x */
+  /*@}*/
+} dfatentry12_tp;
+#endif
+
+#ifdef __unix__
+#pragma pack()
+#endif
+
+/** 
+ *  @typedef  fatentry16_tp
+ *  @brief    Type definition of a FAT entry for 16-bit FAT
+ */
+typedef word_tp fatentry16_tp;
+
+/** 
+ *  @typedef  fatentry32_tp
+ *  @brief    Type definition of a FAT entry for 32-bit FAT
+ */
+typedef dword_tp fatentry32_tp;
+
+/** 
+ *  @typedef  fatentry_tp
+ *  @brief    More simple type definition of a FAT entry in general,
+ *            of course for fatentry16_tp 
+ *            there would be a type adaption necessary
+ */
+typedef dfatentry12_tp fatentry_tp;
+
+
+/* Function declarations */
+
+/**
+ *  @fn       errormessage(int,int)
+ *  @param    errtyp4
+ *  @param    error4
+ *	@brief    General error message 
+ */
+void errormessage(int,int);
+
+/**
+ *  @fn       clustosec(unsigned int,bootsec_tp *)
+ *  @param    cluster
+ *  @param    btptr2
+ *  @return   sector_tp
+ *	@brief    Conversion cluster -> sector 
+ */
+sector_tp clustosec(unsigned int,bootsec_tp *);
+
+/**
+ *  @fn       sectoclus(sector_tp,bootsec_tp *)
+ *  @param    sector
+ *  @param    btptr2
+ *  @return   int
+ *	@brief    Conversion sector -> cluster 
+ */
+int sectoclus(sector_tp,bootsec_tp *);
+
+/**
+ *  @fn       copy_fat(int,fatsec_tp *,bootsec_tp *);
+ *  @param    fatnumber - nth FAT, which is the destionation FAT
+ *  @param    fatptr2
+ *  @param    btptr2
+ *  @return   int
+ *	@brief    Copy the first FAT to the nth FAT, just the different 
+ *            sectors are changed. The number of them is returned, 
+ *            -1 = error
+ */
+int copy_fat(int,fatsec_tp *,bootsec_tp *);
+
+/**
+ *  @fn       get_fatentry12(unsigned int,int,int,dfatentry12_tp *)
+ *  @param    index
+ *  @param    fatlength
+ *  @param    fatnumber
+ *  @param    fatptr2
+ *  @return   unsigned int
+ *	@brief    Calculate the 12-bit FAT entry, error = ERRCLUST 
+ */
+unsigned int get_fatentry12(unsigned int,int,int,dfatentry12_tp *);
+
+/**
+ *  @fn       put_fatentry12(unsigned int,unsigned int,int,int,
+                             dfatentry12_tp *)
+ *  @param    value
+ *  @param    index
+ *  @param    fatlength of one FAT in number of sectors 
+ *  @param    fatnumber
+ *  @param    fatptr2
+ *  @return   unsigned int
  *	@brief    Register / enter the 12-bit FAT entry, error = ERRCLUST 
  */
-unsigned int put_fatentry12(unsigned int,unsigned int,int,int,
-                dfatentry12_tp *);
+unsigned int put_fatentry12(unsigned int,unsigned int,int,int,
+                dfatentry12_tp *);
+
+/**
+ *  @fn       get_fatentry16(unsigned int,int,int,fatentry16_tp *)
+ *  @param    index
+ *  @param    fatlength of one FAT in naumber of sectors
+ *  @param    fatnumber
+ *  @param    fatptr2
+ *  @return   unsigned int
+ *	@brief    Calculate the 16-bit FAT entry, error = ERRCLUST 
+ */
+unsigned int get_fatentry16(unsigned int,int,int,fatentry16_tp *);
+
+/**
+ *  @fn       put_fatentry16(unsigned int,unsigned int,int,int,
+                             fatentry16_tp *)
+ *  @param    value
+ *  @param    index
+ *  @param    fatlength of one FAT in number of sectors 
+ *  @param    fatnumber
+ *  @param    fatptr2
+ *  @return   unsigned int
+ *	@brief    Register / enter the 16-bit FAT entry, error = 0xFF6 (reserved cluster) 
+ */
+unsigned int put_fatentry16(unsigned int,unsigned int,int,int,
+                fatentry16_tp *);
+
+/**
+ *  @fn       get_fatentry32(unsigned int,int,int,fatentry32_tp *)
+ *  @param    index
+ *  @param    fatlength of one FAT in number of sectors
+ *  @param    fatnumber
+ *  @param    fatptr2
+ *  @return   unsigned int
+ *	@brief    Calculate the 28-bit value of a 32-bit FAT entry, 
+ *            error = ERRCLUST 
+ */
+unsigned int get_fatentry32(unsigned int,int,int,fatentry32_tp *);
+
+/**
+ *  @fn       put_fatentry32(unsigned int,unsigned int,int,int,
+                             fatentry32_tp *)
+ *  @param    value
+ *  @param    index
+ *  @param    fatlength of one FAT in number of sectors 
+ *  @param    fatnumber
+ *  @param    fatptr2
+ *  @return   unsigned int
+ *	@brief    Register / enter the 28-bit value of a 32-bit FAT entry,
+ *            the upper 4 bits are kept, error = ERRCLUST
+ */
+unsigned int put_fatentry32(unsigned int,unsigned int,int,int,
+                fatentry32_tp *);
+
+/**
+ *  @fn       unpack_fat12(dfatentry12_tp *,unsigned int *,unsigned int)
+ *  @param    src
+ *  @param    dst
+ *  @param    npairs
+ *	@brief    Decode "npairs" double entries of a 12-bit FAT 
+ *            into 2 * "npairs" values
+ */
+void unpack_fat12(dfatentry12_tp *,unsigned int *,unsigned int);
+
+/**
+ *  @fn       pack_fat12(unsigned int *,dfatentry12_tp *,unsigned int)
+ *  @param    src
+ *  @param    dst
+ *  @param    npairs
+ *	@brief    Encode 2 * "npairs" values 
+ *            into "npairs" double entries of a 12-bit FAT
+ */
+void pack_fat12(unsigned int *,dfatentry12_tp *,unsigned int);
+
+/**
+ *  @fn       get_bootinfo(char,bootsec_tp *)
+ *  @param    drive
+ *  @param    btptr2
+ *  @return   int
+ *	@brief    Importing / reding of the boot sector, calculate the offsets
+ */
+int get_bootinfo(char,bootsec_tp *);
+
+/**
+ *  @fn       put_bootinfo(char,bootsec_tp *)
+ *  @param    drive
+ *  @param    btptr2
+ *  @return   int
+ *	@brief    Exporting / writing of the boot sector
+ */
+int put_bootinfo(char,bootsec_tp *);
+
+/**
+ *  @fn       get_maindir(char,struct direntry_tp *)
+ *  @param    drive
+ *  @param    dirptr2
+ *  @return   int
+ *	@brief    Importing / reading of the main directory
+ */
+int get_maindir(char,struct direntry_tp *);
+
+/**
+ *  @fn       put_maindir(char,struct direntry_tp *)
+ *  @param    drive
+ *  @param    dirptr2
+ *  @return   int
+ *	@brief    Exporting /writing of the modified sectors 
+ *            of the main directory
+ */
+int put_maindir(char,struct direntry_tp *);
+
+/**
+ *  @fn       put_dirsecs(char,struct direntry_tp *,int)
+ *  @param    drive
+ *  @param    dirptr2
+ *  @param    readback - reading instead of writing
+ *  @return   int
+ *	@brief    Write ( or read again ) the modified sectors 
+ *            of the main directory, with FAT32 within its clusters
+ */
+int put_dirsecs(char,struct direntry_tp *,int);
+
+/**
+ *  @fn       get_rootchain(bootsec_tp *)
+ *  @param    btptr2
+ *  @return   int
+ *	@brief    FAT32: Collect the clusters of the main directory,
+ *            and allocate the memory for it
+ */
+int get_rootchain(bootsec_tp *);
+
+/**
+ *  @fn       get_fats(char,fatsec_tp *,bootsec_tp *)
+ *  @param    drive
+ *  @param    fatptr2
+ *  @param    btptr2
+ *  @return   int
+ *	@brief    Importing / reading of all FATs
+ */
+int get_fats(char,fatsec_tp *,bootsec_tp *);
+
+/**
+ *  @fn       put_fats(char,fatsec_tp *,bootsec_tp *)
+ *  @param    drive
+ *  @param    fatptr2
+ *  @param    btptr2
+ *  @return   int
+ *	@brief    Exporting / writing of the modified sectors of all FATs
+ */
+int put_fats(char,fatsec_tp *,bootsec_tp *);
+
+/**
+ *  @fn       alloc_dirty
+ *  @return   int
+ *	@brief    Allocate memory for the bitmaps of the modified
+ *            FAT and directory sectors, all sectors are unmodified
+ */
+int alloc_dirty(void);
+
+/**
+ *  @fn       mark_fatbytes(unsigned int,unsigned int,int,int)
+ *  @param    offset - of the first modified byte within the FAT
+ *  @param    nbytes
+ *  @param    fatlength of one FAT in number of sectors 
+ *  @param    fatnumber
+ *	@brief    Mark the FAT sectors of modified FAT bytes
+ */
+void mark_fatbytes(unsigned int,unsigned int,int,int);
+
+/**
+ *  @fn       mark_direntry(struct direntry_tp *)
+ *  @param    dirptr2
+ *	@brief    Mark the directory sector of a modified directory entry
+ */
+void mark_direntry(struct direntry_tp *);
+
+/**
+ *  @fn       put_dirtysecs(char,unsigned char *,int,sector_tp,void *,int)
+ *  @param    drive
+ *  @param    dirtymap - bitmap of the modified sectors
+ *  @param    nsects
+ *  @param    lsect - logical sector of the first sector
+ *  @param    buffer
+ *  @param    readback - reading instead of writing,
+ *                       to discard the modifications
+ *  @return   int
+ *	@brief    Write just the modified sectors, consecutive sectors
+ *            by a single "abswrite"
+ */
+int put_dirtysecs(char,unsigned char *,int,sector_tp,void *,int);
+
+/**
+ *  @fn       link_startcluster(int,struct direntry_tp *)
+ *  @param    selfentry
+ *  @param    dirptr2
+ *	@brief    Set startcluster for directory := fatentry value
+ */
+void link_startcluster(int,struct direntry_tp *);
+
+/**
+ *  @fn       alloc_sector(bootsec_tp **)
+ *  @param    btptr2
+ *  @return   int
+ *	@brief    Allocate memory for sector
+ */
+int alloc_sector(bootsec_tp **);
+
+/**
+ *  @fn       alloc_cluster(unsigned char **,bootsec_tp *)
+ *  @param    viptr2
+ *  @param    btptr2
+ *  @return   int
+ *	@brief    Allocate memory for cluster ( which consists of several sectors )
+ */
+int alloc_cluster(unsigned char **,bootsec_tp *);
+
+/**
+ *  @fn       alloc_maindir(int,struct direntry_tp **)
+ *  @param    dirlength
+ *  @param    dirptr2
+ *  @return   int
+ *	@brief    Allocate memory for main directory
+ */
+int alloc_maindir(int,struct direntry_tp **);
+
+/**
+ *  @fn       alloc_fats(int,fatsec_tp **)
+ *  @param    fatlength
+ *  @param    fatptr2
+ *  @return   int
+ *	@brief    Allocate memory for FATs
+ */
+int alloc_fats(int,fatsec_tp **);
+
+/**
+ *  @fn       realloc_maindir(int,struct direntry_tp **)
+ *  @param    dirlength
+ *  @param    dirptr2
+ *  @return   int
+ *	@brief    Reallocate memory for main directory
+ */
+int realloc_maindir(int,struct direntry_tp **);
+
+/**
+ *  @fn       realloc_fats(int,fatsec_tp **)
+ *  @param    fatlength
+ *  @param    fatptr2
+ *  @return   int
+ *	@brief    Reallocate memory for FATs
+ */
+int realloc_fats(int,fatsec_tp **);
+
+/**
+ *  @fn       realloc_cluster(unsigned char **,bootsec_tp *)
+ *  @param    viptr2
+ *  @param    btptr2
+ *  @return   int
+ *	@brief    Reallocate memory for cluster ( which consists of several sectors )
+ */
+int realloc_cluster(unsigned char **,bootsec_tp *);
+
+#ifdef IMGDISK
+/**
+ *  @fn       map_maindir(struct direntry_tp **)
+ *  @param    dirptr2
+ *  @return   int
+ *	@brief    Map the main directory within the image file, instead of
+ *            allocating memory for it
+ */
+int map_maindir(struct direntry_tp **);
+
+/**
+ *  @fn       map_fats(fatsec_tp **)
+ *  @param    fatptr2
+ *  @return   int
+ *	@brief    Map the FATs within the image file, instead of
+ *            allocating memory for them
+ */
+int map_fats(fatsec_tp **);
+#endif
+
+/**
+ *  @fn       alloc_cache
+ *  @return   int
+ *	@brief    Allocate memory for the sector cache, 
+ *            according to the memory budget "cache_budget"
+ */
+int alloc_cache(void);
+
+/**
+ *  @fn       cache_find(sector_tp)
+ *  @param    lsect
+ *  @return   int
+ *	@brief    Slot of a logical sector in the sector cache, -1 = not cached
+ */
+int cache_find(sector_tp);
+
+/**
+ *  @fn       cache_touch(int)
+ *  @param    slot
+ *	@brief    Mark a slot of the sector cache as most recently used
+ */
+void cache_touch(int);
+
+/**
+ *  @fn       cache_insert(sector_tp)
+ *  @param    lsect
+ *  @return   unsigned char *
+ *	@brief    Assign the least recently used, unmodified slot 
+ *            to a logical sector, NULL = all slots are modified
+ */
+unsigned char *cache_insert(sector_tp);
+
+/**
+ *  @fn       cache_read(int,int,sector_tp,unsigned char *)
+ *  @param    drive - disk drive number (a=0, b=1, etc)
+ *  @param    nsects
+ *  @param    lsect
+ *  @param    buffer
+ *  @return   int
+ *	@brief    "absread" by the sector cache, zero if successful
+ */
+int cache_read(int,int,sector_tp,unsigned char *);
+
+/**
+ *  @fn       cache_write(int,int,sector_tp,unsigned char *)
+ *  @param    drive - disk drive number (a=0, b=1, etc)
+ *  @param    nsects
+ *  @param    lsect
+ *  @param    buffer
+ *  @return   int
+ *	@brief    "abswrite" by the sector cache, zero if successful.
+ *            The sectors are held until "cache_flush"
+ */
+int cache_write(int,int,sector_tp,unsigned char *);
+
+/**
+ *  @fn       cache_drop(sector_tp,int)
+ *  @param    lsect
+ *  @param    nsects
+ *	@brief    Remove sectors from the sector cache, which are written
+ *            by "abswrite" directly
+ */
+void cache_drop(sector_tp,int);
+
+/**
+ *  @fn       cache_flush(int)
+ *  @param    drive - disk drive number (a=0, b=1, etc)
+ *  @return   int
+ *	@brief    Write back all modified sectors of the sector cache,
+ *            consecutive sectors by a single "abswrite"
+ */
+int cache_flush(int);
+
+/**
+ *  @fn       show_cache
+ *	@brief    Show the statistics and change the memory budget
+ *            of the sector cache
+ */
+void show_cache(void);
+
+/**
+ *  @fn       fat_page(unsigned long,int,int)
+ *  @param    offset - byte offset within the FAT
+ *  @param    fatlength - of one FAT in number of sectors
+ *  @param    fatnumber
+ *  @return   int
+ *	@brief    Slot of the sector cache, which holds a byte of a paged FAT,
+ *            a missing sector is read with the next FATWINDOW-1 sectors.
+ *            -1 = not readable
+ */
+int fat_page(unsigned long,int,int);
+
+/**
+ *  @fn       get_fatbyte(unsigned long,int,int)
+ *  @param    offset
+ *  @param    fatlength
+ *  @param    fatnumber
+ *  @return   int
+ *	@brief    Byte of a paged FAT, -1 = not readable
+ */
+int get_fatbyte(unsigned long,int,int);
+
+/**
+ *  @fn       put_fatbyte(unsigned int,unsigned long,int,int)
+ *  @param    value
+ *  @param    offset
+ *  @param    fatlength
+ *  @param    fatnumber
+ *  @return   int
+ *	@brief    Modify a byte of a paged FAT within the sector cache,
+ *            zero if successful
+ */
+int put_fatbyte(unsigned int,unsigned long,int,int);
+
+/**
+ *  @fn       get_fatsector(int,int,int,unsigned char *)
+ *  @param    sector - within the FAT
+ *  @param    fatlength
+ *  @param    fatnumber
+ *  @param    buffer
+ *  @return   int
+ *	@brief    Copy a sector of a paged FAT into "buffer", zero if successful
+ */
+int get_fatsector(int,int,int,unsigned char *);
+
+/**
+ *  @fn       get_fatentry_paged(unsigned int,int,int)
+ *  @param    index
+ *  @param    fatlength
+ *  @param    fatnumber
+ *  @return   unsigned int
+ *	@brief    FAT entry of a paged FAT, of any FAT type
+ */
+unsigned int get_fatentry_paged(unsigned int,int,int);
+
+/**
+ *  @fn       put_fatentry_paged(unsigned int,unsigned int,int,int)
+ *  @param    value
+ *  @param    index
+ *  @param    fatlength
+ *  @param    fatnumber
+ *  @return   unsigned int
+ *	@brief    Modify a FAT entry of a paged FAT, of any FAT type.
+ *            The value must be checked already
+ */
+unsigned int put_fatentry_paged(unsigned int,unsigned int,int,int);
+
+/**
+ *  @fn       display_bootinfo(bootsec_tp *)
+ *  @param    btptr2
+ *	@brief    Display of the bootsector informations on stdout
+ */
+void display_bootinfo(bootsec_tp *);
+
+/**
+ *  @fn       display_dir(int,struct direntry_tp *)
+ *  @param    dirlength
+ *  @param    dirptr2
+ *	@brief    Display of the directory informations on stdout
+ */
+void display_dir(int,struct direntry_tp *);
+
+/**
+ *  @fn       display_direntry(int,struct direntry_tp *)
+ *  @param    alldisp
+ *  @param    dirptr2
+ *	@brief    Display of a directory entry on stdout
+ */
+void display_direntry(int,struct direntry_tp *);
+
+/**
+ *  @fn       display_fats(int,int,int,fatentry_tp *)
+ *  @param    clusternumber
+ *  @param    fatlength
+ *  @param    fatnumber
+ *  @param    fatptr2
+ *	@brief    Display of the FATs on stdout
+ */
+void display_fats(int,int,int,fatentry_tp *);
+
+/**
+ *  @fn       display_direntries_fatentries(int,int,int,int,fatentry_tp *,
+ *                                          struct direntry_tp *)
+ *  @param    alldisp
+ *  @param    fatlength
+ *  @param    fatnumber
+ *  @param    dirlength
+ *  @param    fatptr2
+ *  @param    dirptr2
+ *	@brief    Display of a FAT entry for each directory entry on stdout
+ */
+void display_direntries_fatentries(int,int,int,int,fatentry_tp *,
+                struct direntry_tp *);
+
+/**
+ *  @fn       display_direntry_fatentries(int,int,int,int,fatentry_tp *,
+ *                                        struct direntry_tp *)
+ *  @param    alldisp
+ *  @param    seldentry
+ *  @param    fatlength
+ *  @param    fatnumber
+ *  @param    fatptr2
+ *  @param    dirptr2
+ *	@brief    Display of a FAT entry for one directory entry on stdout
+ *            ( this function is unused in this software version )
+ */
+void display_direntry_fatentries(int,int,int,int,fatentry_tp *,
+                struct direntry_tp *);
+
+/**
+ *  @fn       modify_fatentry(fatentry_tp *, bootsec_tp *,struct direntry_tp *)
+ *  @param    fatptr2
+ *  @param    btptr2
+ *  @param    dirptr3
+ *	@brief    Modification of FAT entry of a directory entry
+ */
+void modify_fatentry(fatentry_tp *, bootsec_tp *,struct direntry_tp *);
+
+/**
+ *  @fn       newlog(fatsec_tp *,bootsec_tp *,struct direntry_tp *)
+ *  @param    fatptr2
+ *  @param    btptr2
+ *  @param    dirptr2
+ *  @return   int
+ *	@brief    Log onto a new disk
+ */
+int newlog(fatsec_tp *,bootsec_tp *,struct direntry_tp *);
+
+/**
+ *  @fn       writeback(fatsec_tp *,bootsec_tp *,struct direntry_tp *)
+ *  @param    fatptr2
+ *  @param    btptr2
+ *  @param    dirptr2
+ *  @return   int
+ *	@brief    Write back to disk. Returns 0 if it is written back,
+ *            -1 if the write back is declined, else !0 for an error
+ */
+int writeback(fatsec_tp *,bootsec_tp *,struct direntry_tp *);
+
+/**
+ *  @fn       alloc_all
+ *  @return   int
+ *	@brief    Allocate memory for all buffers
+ */
+int alloc_all(void);
+
+/**
+ *  @fn       realloc_all
+ *  @return   int
+ *	@brief    Realloc memory for all buffers
+ */
+int realloc_all(void);
+
+/**
+ *  @fn       alloc_boot
+ *	@brief    Allocate memory for bootsector, 
+ *            just 1x directly after start of program
+ */
+void alloc_boot(void);
+
+/**
+ *  @fn       show_fat_options(int,int,int,int,fatentry_tp *,struct direntry_tp *)
+ *  @param    selfentry
+ *  @param    seldentry
+ *  @param    fatlength
+ *  @param    fatnumber
+ *  @param    fatptr2
+ *  @param    dirptr2
+ *  @return   int
+ *	@brief    Show FAT options
+ */
+int show_fat_options(int,int,int,int,fatentry_tp *,struct direntry_tp *);
+
+/**
+ *  @fn       enter_fatentry(int,int,int,fatentry_tp *)
+ *  @param    selfentry
+ *  @param    fatlength
+ *  @param    fatnumber
+ *  @param    fatptr2
+ *  @return   int
+ *	@brief    Enter a new FAT entry and store it
+ */
+void enter_fatentry(int,int,int,fatentry_tp *);
+
+/**
+ *  @fn       hex_view(char,unsigned char *,bootsec_tp *)
+ *  @param    drive
+ *  @param    viptr2
+ *  @param    btptr2
+ *	@brief    Read sector and display it ( hexdump + ascii ) on stdout
+ *            Assumption: Sector length = 16 x ??
+ */
+void hex_view(char,unsigned char *,bootsec_tp *);
+
+/**
+ *  @fn       ascii_view(char,unsigned char *,bootsec_tp *)
+ *  @param    drive
+ *  @param    viptr2
+ *  @param    btptr2
+ *	@brief    Read sector and display it ( ascii ) on stdout
+ *            Assumption: Sector length = 16 x ??
+ */
+void ascii_view(char,unsigned char *,bootsec_tp *);
+
+/**
+ *  @fn       get_fat_value(int,int,int,fatentry_tp *)
+ *  @param    selfentry
+ *  @param    fatlength
+ *  @param    fatnumber
+ *  @param    fatptr2
+ *  @return   int
+ *	@brief    Import / read / get the contents, which is stored in a FAT entry
+ */
+int get_fat_value(int,int,int,fatentry_tp *);
+
+/**
+ *  @fn       set_fat_value(unsigned int,int,int,int,fatentry_tp *)
+ *  @param    fvalue
+ *  @param    selfentry
+ *  @param    fatlength
+ *  @param    fatnumber
+ *  @param    fatptr2
+ *  @return   unsigned int
+ *	@brief    Export / write / put the contents to a FAT entry,
+ *            without asking, error = ERRCLUST
+ */
+unsigned int set_fat_value(unsigned int,int,int,int,fatentry_tp *);
+
+#ifdef FATSHADOW
+/**
+ *  @fn       build_fatshadow(int,fatentry_tp *)
+ *  @param    fatlength
+ *  @param    fatptr2
+ *  @return   int
+ *	@brief    Decode all entries of the work FAT into "fatshadow"
+ */
+int build_fatshadow(int,fatentry_tp *);
+
+/**
+ *  @fn       flush_fatshadow(int,fatentry_tp *)
+ *  @param    fatlength
+ *  @param    fatptr2
+ *	@brief    Enter the modified entries of "fatshadow" into the work FAT
+ */
+void flush_fatshadow(int,fatentry_tp *);
+#endif
+
+/**
+ *  @fn       free_leaf(unsigned int)
+ *  @param    leaf
+ *	@brief    Calculate the segment tree node of a word of "freemap"
+ */
+void free_leaf(unsigned int);
+
+/**
+ *  @fn       free_join(unsigned int,unsigned int)
+ *  @param    node
+ *  @param    half number of clusters of each of both child nodes
+ *	@brief    Calculate a segment tree node by its two child nodes
+ */
+void free_join(unsigned int,unsigned int);
+
+/**
+ *  @fn       build_freeindex(int,fatentry_tp *)
+ *  @param    fatlength
+ *  @param    fatptr2
+ *  @return   int
+ *	@brief    Build the free cluster bitmap and its segment tree
+ *            by the work FAT
+ */
+int build_freeindex(int,fatentry_tp *);
+
+/**
+ *  @fn       note_fatentry(unsigned int,unsigned int)
+ *  @param    index
+ *  @param    value
+ *	@brief    Update the free space index by a new work FAT entry value
+ */
+void note_fatentry(unsigned int,unsigned int);
+
+/**
+ *  @fn       first_free_run(unsigned int)
+ *  @param    n
+ *  @return   unsigned int
+ *	@brief    First cluster of the first run of "n" free clusters,
+ *            none = NOFAT
+ */
+unsigned int first_free_run(unsigned int);
+
+/**
+ *  @fn       fat_entries(int)
+ *  @param    fatlength
+ *  @return   unsigned int
+ *	@brief    Number of entries of one FAT
+ */
+unsigned int fat_entries(int);
+
+/**
+ *  @fn       decode_fat12(unsigned int,unsigned int,unsigned int,int,int,unsigned char *,unsigned int *)
+ *  @param    first
+ *  @param    count
+ *  @param    entries - of the FAT
+ *  @param    fatlength
+ *  @param    fatnumber
+ *  @param    p - first byte of the FAT
+ *  @param    dst
+ *  @return   unsigned int
+ *	@brief    Decode "count" entries from "first" on into "dst", 
+ *            the number of decoded entries is returned.
+ *            decode_fat16 and decode_fat32 are the same for the other
+ *            FAT widths, decode_fatpg for a paged FAT,
+ *            decode_fatsh for "fatshadow"
+ */
+unsigned int decode_fat12(unsigned int,unsigned int,unsigned int,int,int,
+                          unsigned char *,unsigned int *);
+unsigned int decode_fat16(unsigned int,unsigned int,unsigned int,int,int,
+                          unsigned char *,unsigned int *);
+unsigned int decode_fat32(unsigned int,unsigned int,unsigned int,int,int,
+                          unsigned char *,unsigned int *);
+unsigned int decode_fatpg(unsigned int,unsigned int,unsigned int,int,int,
+                          unsigned char *,unsigned int *);
+#ifdef FATSHADOW
+unsigned int decode_fatsh(unsigned int,unsigned int,unsigned int,int,int,
+                          unsigned int *,unsigned int *);
+#endif
+
+/**
+ *  @fn       chain_length12(unsigned int,unsigned int,int,int,unsigned char *,unsigned int *)
+ *  @param    start
+ *  @param    entries - of the FAT
+ *  @param    fatlength
+ *  @param    fatnumber
+ *  @param    p - first byte of the FAT
+ *  @param    loopstart
+ *  @return   long
+ *	@brief    "chain_length" of a 12-bit FAT, 
+ *            chain_length16, chain_length32, chain_lengthpg and
+ *            chain_lengthsh are the same for the other cases
+ */
+long chain_length12(unsigned int,unsigned int,int,int,
+                    unsigned char *,unsigned int *);
+long chain_length16(unsigned int,unsigned int,int,int,
+                    unsigned char *,unsigned int *);
+long chain_length32(unsigned int,unsigned int,int,int,
+                    unsigned char *,unsigned int *);
+long chain_lengthpg(unsigned int,unsigned int,int,int,
+                    unsigned char *,unsigned int *);
+#ifdef FATSHADOW
+long chain_lengthsh(unsigned int,unsigned int,int,int,
+                    unsigned int *,unsigned int *);
+#endif
+
+/**
+ *  @fn       decode_fats(unsigned int,unsigned int,int,int,fatentry_tp *,unsigned int *)
+ *  @param    first
+ *  @param    count
+ *  @param    fatlength
+ *  @param    fatnumber
+ *  @param    fatptr2
+ *  @param    dst
+ *  @return   unsigned int
+ *	@brief    Decode "count" entries of a FAT from "first" on into "dst",
+ *            by the decoder of the FAT width. 
+ *            The number of decoded entries is returned
+ */
+unsigned int decode_fats(unsigned int,unsigned int,int,int,fatentry_tp *,
+                         unsigned int *);
+
+/**
+ *  @fn       chain_length(unsigned int,int,int,fatentry_tp *,unsigned int *)
+ *  @param    start
+ *  @param    fatlength
+ *  @param    fatnumber
+ *  @param    fatptr2
+ *  @param    loopstart first cluster of a loop, NOFAT = no loop
+ *  @return   long
+ *	@brief    Number of different clusters of the chain from "start" on,
+ *            loops are detected by Brent's algorithm
+ */
+long chain_length(unsigned int,int,int,fatentry_tp *,unsigned int *);
+
+/**
+ *  @fn       display_chain(unsigned int,int,int,fatentry_tp *)
+ *  @param    start
+ *  @param    fatlength
+ *  @param    fatnumber
+ *  @param    fatptr2
+ *	@brief    Display the clusters of a chain just once, and the end value
+ */
+void display_chain(unsigned int,int,int,fatentry_tp *);
+
+/**
+ *  @fn       own_next(unsigned int)
+ *  @param    cl
+ *  @return   unsigned int
+ *	@brief    Next cluster of a chain of the work FAT
+ */
+unsigned int own_next(unsigned int);
+
+/**
+ *  @fn       own_link(unsigned int,int,unsigned int)
+ *  @param    cl
+ *  @param    dentry
+ *  @param    pos
+ *	@brief    Enter the chain from "cl" on as owned by "dentry",
+ *            "cl" is at position "pos"
+ */
+void own_link(unsigned int,int,unsigned int);
+
+/**
+ *  @fn       own_unlink(unsigned int,int,unsigned int)
+ *  @param    cl
+ *  @param    dentry
+ *  @param    pos
+ *  @return   int
+ *	@brief    Remove the clusters of "dentry" from position "pos" on,
+ *            beginning with "cl". Returns "true", if a removed cluster
+ *            is also within the chain of another directory entry
+ */
+int own_unlink(unsigned int,int,unsigned int);
+
+/**
+ *  @fn       build_ownerindex()
+ *  @return   int
+ *	@brief    Build the cluster owner index by all chains
+ *            of the main directory
+ */
+int build_ownerindex(void);
+
+/**
+ *  @fn       owner_fatentry(unsigned int,unsigned int,unsigned int)
+ *  @param    index
+ *  @param    oldvalue
+ *  @param    newvalue
+ *	@brief    Update the cluster owner index by a modified work FAT entry
+ */
+void owner_fatentry(unsigned int,unsigned int,unsigned int);
+
+/**
+ *  @fn       owner_direntry(struct direntry_tp *)
+ *  @param    dirptr2
+ *	@brief    Update the cluster owner index by a modified
+ *            main directory entry
+ */
+void owner_direntry(struct direntry_tp *);
+
+/**
+ *  @fn       show_ranges(char *,unsigned char *)
+ *  @param    title
+ *  @param    map bitmap of clusters
+ *  @return   unsigned int
+ *	@brief    Display the clusters of a bitmap as ranges,
+ *            return the number of clusters
+ */
+unsigned int show_ranges(char *,unsigned char *);
+
+/**
+ *  @fn       reach_chain(unsigned int,unsigned char *,int,fatentry_tp *)
+ *  @param    start
+ *  @param    reach
+ *  @param    fatlength
+ *  @param    fatptr2
+ *	@brief    Mark the clusters of the chain within the bitmap "reach",
+ *            up to a cluster, which is already marked
+ */
+void reach_chain(unsigned int,unsigned char *,int,fatentry_tp *);
+
+/**
+ *  @fn       check_fat(fatsec_tp *,bootsec_tp *,struct direntry_tp *)
+ *  @param    fatptr2
+ *  @param    btptr2
+ *  @param    dirptr2
+ *	@brief    Check the work FAT by the in-degrees of all clusters,
+ *            with a single pass over the FAT
+ */
+void check_fat(fatsec_tp *,bootsec_tp *,struct direntry_tp *);
+
+/**
+ *  @fn       fat_plausibility(unsigned int,unsigned int,int,int,fatentry_tp *,unsigned char *)
+ *  @param    value
+ *  @param    index
+ *  @param    fatlength
+ *  @param    fatnumber
+ *  @param    fatptr2
+ *  @param    refmap - bitmap of the referenced clusters of this FAT
+ *  @return   int
+ *	@brief    Plausibility of a FAT entry value, 0 = impossible ... 2
+ */
+int fat_plausibility(unsigned int,unsigned int,int,int,fatentry_tp *,
+                     unsigned char *);
+
+/**
+ *  @fn       compare_fats(fatsec_tp *,bootsec_tp *,struct direntry_tp *)
+ *  @param    fatptr2
+ *  @param    btptr2
+ *  @param    dirptr2
+ *	@brief    Show the entries, which differ between the FATs.
+ *            Repair the work FAT by the majority of the FATs, or by
+ *            the plausibility of the values, then copy it to the others
+ */
+void compare_fats(fatsec_tp *,bootsec_tp *,struct direntry_tp *);
+
+/**
+ *  @fn       wrong_fat_value(unsigned int,unsigned int)
+ *  @param    fvalue
+ *  @param    selfentry
+ *  @return   int
+ *	@brief    "true", if the value can't be entered into the FAT entry
+ */
+int wrong_fat_value(unsigned int,unsigned int);
+
+/**
+ *  @fn       link_run(unsigned int,int,fatentry_tp *,bootsec_tp *,struct direntry_tp *)
+ *  @param    first - first cluster of the chain
+ *  @param    fatlength
+ *  @param    fatptr2
+ *  @param    btptr2
+ *  @param    dirptr2 - the selected directory entry
+ *	@brief    Link the consecutive clusters first...last into a chain,
+ *            for files, which were copied one after another. 
+ *            Optional, set the startcluster and the filelength
+ *            of the directory entry
+ */
+void link_run(unsigned int,int,fatentry_tp *,bootsec_tp *,
+              struct direntry_tp *);
+
+/**
+ *  @fn       get_clusters(unsigned int,unsigned int,unsigned char *,bootsec_tp *)
+ *  @param    cl - first cluster
+ *  @param    n - number of consecutive clusters
+ *  @param    buffer - for n clusters
+ *  @param    btptr2
+ *  @return   unsigned char *
+ *	@brief    Contents of consecutive clusters, within the mapping
+ *            of an image file or read into "buffer", NULL = read error
+ */
+unsigned char *get_clusters(unsigned int,unsigned int,unsigned char *,
+                            bootsec_tp *);
+
+/**
+ *  @fn       classify_cluster(unsigned char *,unsigned int)
+ *  @param    data
+ *  @param    nbytes
+ *  @return   int
+ *	@brief    Class of the contents of a cluster, CLZERO...CLBINARY
+ */
+int classify_cluster(unsigned char *,unsigned int);
+
+/**
+ *  @fn       build_classmap(bootsec_tp *)
+ *  @param    btptr2
+ *  @return   int
+ *	@brief    Classify all clusters of the data area into "classmap"
+ */
+int build_classmap(bootsec_tp *);
+
+/**
+ *  @fn       cluster_class(unsigned int)
+ *  @param    cl
+ *  @return   int
+ *	@brief    Class of a cluster, CLUNKNOWN if not yet classified
+ */
+int cluster_class(unsigned int);
+
+/**
+ *  @fn       next_text_cluster(unsigned int,int,fatentry_tp *)
+ *  @param    cl
+ *  @param    fatlength
+ *  @param    fatptr2
+ *  @return   unsigned int
+ *	@brief    Next free text cluster after "cl", none = NOFAT
+ */
+unsigned int next_text_cluster(unsigned int,int,fatentry_tp *);
+
+/**
+ *  @fn       show_classes(bootsec_tp *)
+ *  @param    btptr2
+ *	@brief    Classify all clusters, show the number of each class
+ *            and the text clusters
+ */
+void show_classes(bootsec_tp *);
+
+/**
+ *  @fn       text_features(unsigned char *,unsigned int,struct textinfo_tp *)
+ *  @param    data
+ *  @param    nbytes
+ *  @param    info
+ *	@brief    Features of the start and the end of a text cluster
+ */
+void text_features(unsigned char *,unsigned int,struct textinfo_tp *);
+
+/**
+ *  @fn       text_score(struct textinfo_tp *,struct textinfo_tp *)
+ *  @param    a
+ *  @param    b
+ *  @return   int
+ *	@brief    Score, how well the text of cluster "b" continues
+ *            the text of cluster "a"
+ */
+int text_score(struct textinfo_tp *,struct textinfo_tp *);
+
+/**
+ *  @fn       gram_weight(unsigned int)
+ *  @param    count
+ *  @return   int
+ *	@brief    Score of a triple of bytes, by how often it is found
+ */
+int gram_weight(unsigned int);
+
+/**
+ *  @fn       count_grams(unsigned char *,unsigned int)
+ *  @param    data
+ *  @param    nbytes
+ *	@brief    Count the triples of bytes of a text cluster in "gramtab"
+ */
+void count_grams(unsigned char *,unsigned int);
+
+/**
+ *  @fn       cluster_distance(unsigned int,unsigned int)
+ *  @param    i
+ *  @param    j
+ *  @return   unsigned int
+ *	@brief    Distance from text cluster "i" upwards to text cluster "j"
+ *            of "textinfo", around the end of the data area
+ */
+unsigned int cluster_distance(unsigned int,unsigned int);
+
+/**
+ *  @fn       free_suggestindex()
+ *	@brief    Free the index of the suggested next clusters
+ */
+void free_suggestindex(void);
+
+/**
+ *  @fn       build_suggestindex(bootsec_tp *)
+ *  @param    btptr2
+ *  @return   int
+ *	@brief    Find the SUGGESTK best next clusters of each text cluster
+ */
+int build_suggestindex(bootsec_tp *);
+
+/**
+ *  @fn       head_bound(struct textinfo_tp *,unsigned int)
+ *  @param    a
+ *  @param    f
+ *  @return   int
+ *	@brief    Upper bound of "text_score" of the text cluster "a"
+ *            with each text cluster, which begins with the byte "f"
+ */
+int head_bound(struct textinfo_tp *,unsigned int);
+
+/**
+ *  @fn       suggest_insert(unsigned int,unsigned int,int)
+ *  @param    i
+ *  @param    j
+ *  @param    score
+ *	@brief    Insert the text cluster "j" into the suggestions of "i"
+ */
+void suggest_insert(unsigned int,unsigned int,int);
+
+/**
+ *  @fn       find_textinfo(unsigned int)
+ *  @param    cl
+ *  @return   int
+ *	@brief    Position of a cluster within "textinfo", -1 = no text cluster
+ */
+int find_textinfo(unsigned int);
+
+/**
+ *  @fn       suggest_next(unsigned int,int,fatentry_tp *,bootsec_tp *)
+ *  @param    selfentry
+ *  @param    fatlength
+ *  @param    fatptr2
+ *  @param    btptr2
+ *  @return   unsigned int
+ *	@brief    Show the suggested next clusters of a text cluster,
+ *            link it to one of them. The new fatentry is returned
+ */
+unsigned int suggest_next(unsigned int,int,fatentry_tp *,bootsec_tp *);
+
+/**
+ *  @fn       fill_direntry(struct direntry_tp *,char *,char *,int,unsigned int,long)
+ *  @param    dp
+ *  @param    name
+ *  @param    ext
+ *  @param    attribute
+ *  @param    start
+ *  @param    length
+ *	@brief    Fill a direntry, with the date 1.1.1980
+ */
+void fill_direntry(struct direntry_tp *,char *,char *,int,unsigned int,long);
+
+/**
+ *  @fn       make_direntry(char *,char *,unsigned int,long,bootsec_tp *,struct direntry_tp *)
+ *  @param    name
+ *  @param    ext
+ *  @param    start
+ *  @param    length
+ *  @param    btptr2
+ *  @param    dirptr2
+ *  @return   struct direntry_tp *
+ *	@brief    Create a file within the first free entry of the main directory,
+ *            NULL = the main directory is full
+ */
+struct direntry_tp *make_direntry(char *,char *,unsigned int,long,
+                                  bootsec_tp *,struct direntry_tp *);
+
+/**
+ *  @fn       reassemble_text(int,fatentry_tp *,bootsec_tp *,struct direntry_tp *)
+ *  @param    fatlength
+ *  @param    fatptr2
+ *  @param    btptr2
+ *  @param    dirptr2
+ *	@brief    Order all free text clusters into files by the best
+ *            path cover of the scores of the cluster borders,
+ *            save the confirmed files in the FAT and the main directory
+ */
+void reassemble_text(int,fatentry_tp *,bootsec_tp *,struct direntry_tp *);
+
+/**
+ *  @fn       parse_pattern(char *,unsigned char *)
+ *  @param    text
+ *  @param    pattern
+ *  @return   int
+ *	@brief    Convert a text, or "$" and hex bytes, into a search pattern.
+ *            The length is returned, -1 = wrong hex bytes
+ */
+int parse_pattern(char *,unsigned char *);
+
+/**
+ *  @fn       search_clusters(unsigned char *,int,unsigned int *,unsigned int *,unsigned int,bootsec_tp *)
+ *  @param    pattern
+ *  @param    len
+ *  @param    hitcl
+ *  @param    hitoff
+ *  @param    maxhits
+ *  @param    btptr2
+ *  @return   unsigned long
+ *	@brief    Search the whole data area for a pattern, the clusters and
+ *            offsets of the first "maxhits" hits are saved.
+ *            The number of hits is returned
+ */
+unsigned long search_clusters(unsigned char *,int,unsigned int *,unsigned int *,
+                              unsigned int,bootsec_tp *);
 
 /**
- *  @fn       get_fatentry16(unsigned int,int,int,fatentry16_tp *)
- *  @param    index
- *  @param    fatlength of one FAT in naumber of sectors
- *  @param    fatnumber
+ *  @fn       search_content(unsigned int,int,fatentry_tp *,bootsec_tp *)
+ *  @param    selfentry
+ *  @param    fatlength
  *  @param    fatptr2
+ *  @param    btptr2
  *  @return   unsigned int
- *	@brief    Calculate the 16-bit FAT entry, error = ERRCLUST 
+ *	@brief    Search all clusters for a text or bytes, show the hits.
+ *            The cluster of the chosen hit is returned as new fatentry
  */
-unsigned int get_fatentry16(unsigned int,int,int,fatentry16_tp *);
+unsigned int search_content(unsigned int,int,fatentry_tp *,bootsec_tp *);
 
 /**
- *  @fn       put_fatentry16(unsigned int,unsigned int,int,int,
-                             fatentry16_tp *)
- *  @param    value
+ *  @fn       ac_insert(struct acauto_tp *,unsigned char *,int,int)
+ *  @param    ac
+ *  @param    pattern
+ *  @param    len
  *  @param    index
- *  @param    fatlength of one FAT in number of sectors 
- *  @param    fatnumber
- *  @param    fatptr2
  *  @return   unsigned int
- *	@brief    Register / enter the 16-bit FAT entry, error = 0xFF6 (reserved cluster) 
+ *	@brief    Insert a pattern into the automaton.
+ *            The last node is returned, 0 = too many nodes
  */
-unsigned int put_fatentry16(unsigned int,unsigned int,int,int,
-                fatentry16_tp *);
+unsigned int ac_insert(struct acauto_tp *,unsigned char *,int,int);
 
 /**
- *  @fn       get_bootinfo(char,bootsec_tp *)
- *  @param    drive
- *  @param    btptr2
- *  @return   int
- *	@brief    Importing / reding of the boot sector, calculate the offsets
+ *  @fn       ac_step(struct acauto_tp *,unsigned int,unsigned char)
+ *  @param    ac
+ *  @param    state
+ *  @param    c
+ *  @return   unsigned int
+ *	@brief    Next state of the automaton after the byte "c"
  */
-int get_bootinfo(char,bootsec_tp *);
+unsigned int ac_step(struct acauto_tp *,unsigned int,unsigned char);
 
 /**
- *  @fn       put_bootinfo(char,bootsec_tp *)
- *  @param    drive
- *  @param    btptr2
+ *  @fn       ac_build(struct acauto_tp *)
+ *  @param    ac
  *  @return   int
- *	@brief    Exporting / writing of the boot sector
+ *	@brief    Find the failure links of all nodes
  */
-int put_bootinfo(char,bootsec_tp *);
+int ac_build(struct acauto_tp *);
 
 /**
- *  @fn       get_maindir(char,struct direntry_tp *)
- *  @param    drive
- *  @param    dirptr2
+ *  @fn       ac_load(char *,struct acauto_tp *)
+ *  @param    filename
+ *  @param    ac
  *  @return   int
- *	@brief    Importing / reading of the main directory
+ *	@brief    Build the automaton of the patterns of a pattern file,
+ *            one pattern per line like the search of the FAT menu.
+ *            The number of patterns is returned, -1 = error
  */
-int get_maindir(char,struct direntry_tp *);
+int ac_load(char *,struct acauto_tp *);
 
 /**
- *  @fn       put_maindir(char,struct direntry_tp *)
- *  @param    drive
- *  @param    dirptr2
+ *  @fn       scan_patterns(bootsec_tp *)
+ *  @param    btptr2
+ *	@brief    Search all clusters for the patterns of a pattern file
+ *            in one pass, show the hit matrix of clusters and patterns
+ */
+void scan_patterns(bootsec_tp *);
+
+/**
+ *  @fn       carve_byte(struct carveread_tp *,unsigned long)
+ *  @param    r
+ *  @param    offset
  *  @return   int
- *	@brief    Exporting /writing of the main directory
+ *	@brief    Byte of a contiguous file, -1 = beyond the data area
  */
-int put_maindir(char,struct direntry_tp *);
+int carve_byte(struct carveread_tp *,unsigned long);
 
 /**
- *  @fn       get_fats(char,fatsec_tp *,bootsec_tp *)
- *  @param    drive
- *  @param    fatptr2
+ *  @fn       carve_le(struct carveread_tp *,unsigned long,int)
+ *  @param    r
+ *  @param    offset
+ *  @param    n
+ *  @return   long
+ *	@brief    Little endian value of "n" bytes of a contiguous file,
+ *            -1 = beyond the data area
+ */
+long carve_le(struct carveread_tp *,unsigned long,int);
+
+/**
+ *  @fn       carve_find(struct carveread_tp *,unsigned long,unsigned char *,int)
+ *  @param    r
+ *  @param    offset
+ *  @param    footer
+ *  @param    len
+ *  @return   long
+ *	@brief    Offset of the next footer of a contiguous file, -1 = none
+ */
+long carve_find(struct carveread_tp *,unsigned long,unsigned char *,int);
+
+/**
+ *  @fn       carve_extent(int,struct carveread_tp *)
+ *  @param    kind
+ *  @param    r
+ *  @return   long
+ *	@brief    Filelength by the header or by the footer of a binary file,
+ *            0 = unknown, -1 = the header is wrong
+ */
+long carve_extent(int,struct carveread_tp *);
+
+/**
+ *  @fn       carve_files(struct carvecand_tp *,unsigned int,bootsec_tp *)
+ *  @param    cand
+ *  @param    maxcand
  *  @param    btptr2
- *  @return   int
- *	@brief    Importing / reading of all FATs
+ *  @return   unsigned int
+ *	@brief    Find the clusters starting with the header of a binary file.
+ *            The number of found files is returned
  */
-int get_fats(char,fatsec_tp *,bootsec_tp *);
+unsigned int carve_files(struct carvecand_tp *,unsigned int,bootsec_tp *);
 
 /**
- *  @fn       put_fats(char,fatsec_tp *,bootsec_tp *)
- *  @param    drive
+ *  @fn       carve_menu(int,fatentry_tp *,bootsec_tp *,struct direntry_tp *)
+ *  @param    fatlength
  *  @param    fatptr2
  *  @param    btptr2
- *  @return   int
- *	@brief    Exporting / writing of all FATs
+ *  @param    dirptr2
+ *	@brief    Show the binary files found by carving, link one of them
+ *            as contiguous chain into the FAT and to a direntry
  */
-int put_fats(char,fatsec_tp *,bootsec_tp *);
+void carve_menu(int,fatentry_tp *,bootsec_tp *,struct direntry_tp *);
 
 /**
- *  @fn       link_startcluster(int,struct direntry_tp *)
- *  @param    selfentry
- *  @param    dirptr2
- *	@brief    Set startcluster for directory := fatentry value
+ *  @fn       hash_cluster(unsigned char *,unsigned int)
+ *  @param    data
+ *  @param    nbytes
+ *  @return   unsigned long
+ *	@brief    FNV-1a hash of 32 bits of the contents of a cluster
  */
-void link_startcluster(int,struct direntry_tp *);
+unsigned long hash_cluster(unsigned char *,unsigned int);
 
 /**
- *  @fn       alloc_sector(bootsec_tp **)
+ *  @fn       put_le(FILE *,unsigned long,int)
+ *  @param    fp
+ *  @param    value
+ *  @param    n
+ *	@brief    Write a value as "n" bytes, little endian
+ */
+void put_le(FILE *,unsigned long,int);
+
+/**
+ *  @fn       get_le(FILE *,int)
+ *  @param    fp
+ *  @param    n
+ *  @return   unsigned long
+ *	@brief    Read a value of "n" bytes, little endian
+ */
+unsigned long get_le(FILE *,int);
+
+/**
+ *  @fn       write_hashindex(char *,int,fatentry_tp *,bootsec_tp *,struct direntry_tp *)
+ *  @param    filename
+ *  @param    fatlength
+ *  @param    fatptr2
  *  @param    btptr2
+ *  @param    dirptr2
  *  @return   int
- *	@brief    Allocate memory for sector
+ *	@brief    Write the hash and the FAT entry of each cluster and
+ *            the files of the main directory into a hash index file
  */
-int alloc_sector(bootsec_tp **);
+int write_hashindex(char *,int,fatentry_tp *,bootsec_tp *,struct direntry_tp *);
 
 /**
- *  @fn       alloc_cluster(unsigned char **,bootsec_tp *)
- *  @param    viptr2
+ *  @fn       match_hashindex(char *,int,fatentry_tp *,bootsec_tp *,struct direntry_tp *)
+ *  @param    filename
+ *  @param    fatlength
+ *  @param    fatptr2
  *  @param    btptr2
- *  @return   int
- *	@brief    Allocate memory for cluster ( which consists of several sectors )
+ *  @param    dirptr2
+ *	@brief    Find the clusters of a reference disk by their hashes,
+ *            link the files of the reference, which are found completely,
+ *            into the FAT and the main directory. A hash found twice is
+ *            no match, allocated clusters are relinked on request only
  */
-int alloc_cluster(unsigned char **,bootsec_tp *);
+void match_hashindex(char *,int,fatentry_tp *,bootsec_tp *,struct direntry_tp *);
 
 /**
- *  @fn       alloc_maindir(int,struct direntry_tp **)
- *  @param    dirlength
+ *  @fn       hash_menu(int,fatentry_tp *,bootsec_tp *,struct direntry_tp *)
+ *  @param    fatlength
+ *  @param    fatptr2
+ *  @param    btptr2
  *  @param    dirptr2
- *  @return   int
- *	@brief    Allocate memory for main directory
+ *	@brief    Write a hash index, or match with a hash index
  */
-int alloc_maindir(int,struct direntry_tp **);
+void hash_menu(int,fatentry_tp *,bootsec_tp *,struct direntry_tp *);
 
 /**
- *  @fn       alloc_fats(int,fatsec_tp **)
+ *  @fn       rebuild_fat(int,fatentry_tp *,bootsec_tp *,struct direntry_tp *)
  *  @param    fatlength
  *  @param    fatptr2
- *  @return   int
- *	@brief    Allocate memory for FATs
+ *  @param    btptr2
+ *  @param    dirptr2
+ *	@brief    Rebuild the work FAT by the startclusters and filelengths
+ *            of the main directory, each file is assumed to be contiguous.
+ *            The bad clusters and the chains of the subdirectories and
+ *            their files are kept. Overlaps of the files are reported
  */
-int alloc_fats(int,fatsec_tp **);
+void rebuild_fat(int,fatentry_tp *,bootsec_tp *,struct direntry_tp *);
 
 /**
- *  @fn       realloc_maindir(int,struct direntry_tp **)
- *  @param    dirlength
+ *  @fn       chk_exists(char *,char *,struct direntry_tp *,int)
+ *  @param    name
+ *  @param    ext
  *  @param    dirptr2
+ *  @param    entries
  *  @return   int
- *	@brief    Reallocate memory for main directory
+ *	@brief    The name is used within the directory
  */
-int realloc_maindir(int,struct direntry_tp **);
+int chk_exists(char *,char *,struct direntry_tp *,int);
 
 /**
- *  @fn       realloc_fats(int,fatsec_tp **)
+ *  @fn       make_chkfiles(int,fatentry_tp *,bootsec_tp *,struct direntry_tp *)
  *  @param    fatlength
  *  @param    fatptr2
- *  @return   int
- *	@brief    Reallocate memory for FATs
+ *  @param    btptr2
+ *  @param    dirptr2
+ *	@brief    Create a FILEnnnn.CHK entry for each chain, which no
+ *            direntry of the directory tree and no cluster links to.
+ *            If the main directory is full, the entries go into a new
+ *            FOUND.nnn, which is written with the write back
  */
-int realloc_fats(int,fatsec_tp **);
+void make_chkfiles(int,fatentry_tp *,bootsec_tp *,struct direntry_tp *);
 
 /**
- *  @fn       realloc_cluster(unsigned char **,bootsec_tp *)
- *  @param    viptr2
- *  @param    btptr2
- *  @return   int
- *	@brief    Reallocate memory for cluster ( which consists of several sectors )
+ *  @fn       free_dirtree
+ *	@brief    Free the directory tree
  */
-int realloc_cluster(unsigned char **,bootsec_tp *);
+void free_dirtree(void);
 
 /**
- *  @fn       display_bootinfo(bootsec_tp *)
- *  @param    btptr2
- *	@brief    Display of the bootsector informations on stdout
+ *  @fn       node_dir(int)
+ *  @param    nd
+ *  @return   struct direntry_tp *
+ *	@brief    The direntries of a node of the directory tree
  */
-void display_bootinfo(bootsec_tp *);
+struct direntry_tp *node_dir(int);
 
 /**
- *  @fn       display_dir(int,struct direntry_tp *)
- *  @param    dirlength
- *  @param    dirptr2
- *	@brief    Display of the directory informations on stdout
+ *  @fn       node_entries(int)
+ *  @param    nd
+ *  @return   unsigned int
+ *	@brief    The number of direntries of a node of the directory tree
  */
-void display_dir(int,struct direntry_tp *);
+unsigned int node_entries(int);
 
 /**
- *  @fn       display_direntry(int,struct direntry_tp *)
- *  @param    alldisp
+ *  @fn       find_dirnode(unsigned int)
+ *  @param    start
+ *  @return   int
+ *	@brief    The node of the directory tree with this startcluster,
+ *            -1 if there is none
+ */
+int find_dirnode(unsigned int);
+
+/**
+ *  @fn       mark_dirnode(struct direntry_tp *)
  *  @param    dirptr2
- *	@brief    Display of a directory entry on stdout
+ *	@brief    Mark the subdirectory of the direntry as modified
  */
-void display_direntry(int,struct direntry_tp *);
+void mark_dirnode(struct direntry_tp *);
 
 /**
- *  @fn       display_fats(int,int,int,fatentry_tp *)
- *  @param    clusternumber
+ *  @fn       dirnode_runs(int,int,fatentry_tp *,bootsec_tp *,int)
+ *  @param    nd
  *  @param    fatlength
- *  @param    fatnumber
  *  @param    fatptr2
- *	@brief    Display of the FATs on stdout
+ *  @param    btptr2
+ *  @param    writing
+ *  @return   long
+ *	@brief    Read or write the clusters of a subdirectory, each contiguous
+ *            run of the chain by a single transfer. Returns the number
+ *            of transfers, -1 for an error
  */
-void display_fats(int,int,int,fatentry_tp *);
+long dirnode_runs(int,int,fatentry_tp *,bootsec_tp *,int);
 
 /**
- *  @fn       display_direntries_fatentries(int,int,int,int,fatentry_tp *,
- *                                          struct direntry_tp *)
- *  @param    alldisp
+ *  @fn       read_dirnode(int,int,fatentry_tp *,bootsec_tp *)
+ *  @param    nd
  *  @param    fatlength
- *  @param    fatnumber
- *  @param    dirlength
  *  @param    fatptr2
- *  @param    dirptr2
- *	@brief    Display of a FAT entry for each directory entry on stdout
+ *  @param    btptr2
+ *  @return   long
+ *	@brief    Allocate and read a subdirectory, up to DIRBUFMAX bytes.
+ *            Returns the number of reads, -1 for an error
  */
-void display_direntries_fatentries(int,int,int,int,fatentry_tp *,
-                struct direntry_tp *);
+long read_dirnode(int,int,fatentry_tp *,bootsec_tp *);
 
 /**
- *  @fn       display_direntry_fatentries(int,int,int,int,fatentry_tp *,
- *                                        struct direntry_tp *)
- *  @param    alldisp
- *  @param    seldentry
+ *  @fn       write_dirnode(int,int,fatentry_tp *,bootsec_tp *)
+ *  @param    nd
  *  @param    fatlength
- *  @param    fatnumber
  *  @param    fatptr2
- *  @param    dirptr2
- *	@brief    Display of a FAT entry for one directory entry on stdout
- *            ( this function is unused in this software version )
+ *  @param    btptr2
+ *  @return   int
+ *	@brief    Write back a subdirectory
  */
-void display_direntry_fatentries(int,int,int,int,fatentry_tp *,
-                struct direntry_tp *);
+int write_dirnode(int,int,fatentry_tp *,bootsec_tp *);
 
 /**
- *  @fn       modify_fatentry(fatentry_tp *, bootsec_tp *,struct direntry_tp *)
+ *  @fn       load_dirtree(int,fatentry_tp *,bootsec_tp *)
+ *  @param    fatlength
  *  @param    fatptr2
  *  @param    btptr2
- *  @param    dirptr3
- *	@brief    Modification of FAT entry of a directory entry
+ *  @return   int
+ *	@brief    Load all subdirectories, breadth first from the main
+ *            directory, by the chains of the SUBDIR entries
  */
-void modify_fatentry(fatentry_tp *, bootsec_tp *,struct direntry_tp *);
+int load_dirtree(int,fatentry_tp *,bootsec_tp *);
 
 /**
- *  @fn       newlog(fatsec_tp *,bootsec_tp *,struct direntry_tp *)
+ *  @fn       put_dirtree(int,fatentry_tp *,bootsec_tp *)
+ *  @param    fatlength
  *  @param    fatptr2
  *  @param    btptr2
- *  @param    dirptr2
  *  @return   int
- *	@brief    Log onto a new disk
+ *	@brief    Write back the modified subdirectories
  */
-int newlog(fatsec_tp *,bootsec_tp *,struct direntry_tp *);
+int put_dirtree(int,fatentry_tp *,bootsec_tp *);
 
 /**
- *  @fn       writeback(fatsec_tp *,bootsec_tp *,struct direntry_tp *)
+ *  @fn       refresh_dirtree(int,fatentry_tp *,bootsec_tp *)
+ *  @param    fatlength
  *  @param    fatptr2
  *  @param    btptr2
- *  @param    dirptr2
  *  @return   int
- *	@brief    Write back to disk
+ *	@brief    Load the directory tree again, unless a subdirectory
+ *            is modified and not yet written back
  */
-int writeback(fatsec_tp *,bootsec_tp *,struct direntry_tp *);
+int refresh_dirtree(int,fatentry_tp *,bootsec_tp *);
 
 /**
- *  @fn       alloc_all
+ *  @fn       display_nodepath(int)
+ *  @param    nd
+ *	@brief    Display the path of a node of the directory tree
+ */
+void display_nodepath(int);
+
+/**
+ *  @fn       show_dirtree(int,fatentry_tp *,bootsec_tp *)
+ *  @param    fatlength
+ *  @param    fatptr2
+ *  @param    btptr2
+ *	@brief    Display the directory tree, it is loaded before if necessary
+ */
+void show_dirtree(int,fatentry_tp *,bootsec_tp *);
+
+/**
+ *  @fn       open_subdir(struct direntry_tp *,int,fatentry_tp *,bootsec_tp *)
+ *  @param    dirptr2
+ *  @param    fatlength
+ *  @param    fatptr2
+ *  @param    btptr2
  *  @return   int
- *	@brief    Allocate memory for all buffers
+ *	@brief    Enter the subdirectory of the direntry, also "." and "..",
+ *            returns "true" if the current directory is changed
  */
-int alloc_all(void);
+int open_subdir(struct direntry_tp *,int,fatentry_tp *,bootsec_tp *);
 
 /**
- *  @fn       realloc_all
+ *  @fn       batch_parse(char *,struct batchedit_tp *)
+ *  @param    line
+ *  @param    edit
  *  @return   int
- *	@brief    Realloc memory for all buffers
+ *	@brief    Parse a line of an edit script, 
+ *            0 = edit, 1 = empty or comment line, -1 = wrong line.
+ *            "F index value" : FAT entry, value hex or FREE/EOF/BAD,
+ *            "D entry field value" : directory entry, field
+ *            NAME/EXT ( text ) or ATTR/START/LENGTH ( hex ),
+ *            ";" : comment
  */
-int realloc_all(void);
+int batch_parse(char *,struct batchedit_tp *);
 
 /**
- *  @fn       alloc_boot
- *	@brief    Allocate memory for bootsector, 
- *            just 1x directly after start of program
+ *  @fn       batch_load(char *,struct batchedit_tp **)
+ *  @param    filename
+ *  @param    edits
+ *  @return   int
+ *	@brief    Read all edits of an edit script, the number of them
+ *            is returned, -1 = error
  */
-void alloc_boot(void);
+int batch_load(char *,struct batchedit_tp **);
 
 /**
- *  @fn       show_fat_options(int,int,int,int,fatentry_tp *,struct direntry_tp *)
- *  @param    selfentry
- *  @param    seldentry
+ *  @fn       batch_check(struct batchedit_tp *,int,int)
+ *  @param    edits
+ *  @param    n
  *  @param    fatlength
- *  @param    fatnumber
- *  @param    fatptr2
- *  @param    dirptr2
  *  @return   int
- *	@brief    Show FAT options
+ *	@brief    Check all edits, before any of them is done,
+ *            zero if all are possible
  */
-int show_fat_options(int,int,int,int,fatentry_tp *,struct direntry_tp *);
+int batch_check(struct batchedit_tp *,int,int);
 
 /**
- *  @fn       enter_fatentry(int,int,int,fatentry_tp *)
- *  @param    selfentry
+ *  @fn       batch_apply(struct batchedit_tp *,int,int,fatentry_tp *,struct direntry_tp *)
+ *  @param    edits
+ *  @param    n
  *  @param    fatlength
- *  @param    fatnumber
  *  @param    fatptr2
- *  @return   int
- *	@brief    Enter a new FAT entry and store it
+ *  @param    dirptr2
+ *	@brief    Do all checked edits in the work FAT and the main directory
  */
-void enter_fatentry(int,int,int,fatentry_tp *);
+void batch_apply(struct batchedit_tp *,int,int,fatentry_tp *,
+                 struct direntry_tp *);
 
 /**
- *  @fn       hex_view(char,unsigned char *,bootsec_tp *)
- *  @param    drive
- *  @param    viptr2
+ *  @fn       run_batch(fatsec_tp *,bootsec_tp *,struct direntry_tp *)
+ *  @param    fatptr2
  *  @param    btptr2
- *	@brief    Read sector and display it ( hexdump + ascii ) on stdout
- *            Assumption: Sector length = 16 x ??
+ *  @param    dirptr2
+ *	@brief    Read, check and do an edit script, then write back
  */
-void hex_view(char,unsigned char *,bootsec_tp *);
+void run_batch(fatsec_tp *,bootsec_tp *,struct direntry_tp *);
 
 /**
- *  @fn       ascii_view(char,unsigned char *,bootsec_tp *)
- *  @param    drive
- *  @param    viptr2
- *  @param    btptr2
- *	@brief    Read sector and display it ( ascii ) on stdout
- *            Assumption: Sector length = 16 x ??
+ *  @fn       show_freespace()
+ *	@brief    Display the number of free clusters,
+ *            search a run of free clusters
  */
-void ascii_view(char,unsigned char *,bootsec_tp *);
+void show_freespace(void);
 
+#ifdef BTEST
 /**
- *  @fn       get_fat_value(int,int,int,fatentry_tp *)
- *  @param    selfentry
- *  @param    fatlength
- *  @param    fatnumber
+ *  @fn       benchmark_fat12(fatsec_tp *,bootsec_tp *)
  *  @param    fatptr2
- *  @return   int
- *	@brief    Import / read / get the contents, which is stored in a FAT entry
+ *  @param    btptr2
+ *	@brief    Compare the timing of "get_fatentry12" / "put_fatentry12" 
+ *            with "unpack_fat12" / "pack_fat12" over the whole work FAT
  */
-int get_fat_value(int,int,int,fatentry_tp *);
+void benchmark_fat12(fatsec_tp *,bootsec_tp *);
+
+/**
+ *  @fn       benchmark_chains()
+ *	@brief    Compare the time per link of a chain walk by "get_fat_value"
+ *            with "chain_length", for a test chain of each FAT width
+ */
+void benchmark_chains(void);
+#endif
 
 /**
  *  @fn       put_fat_value(int,int,int,int,fatentry_tp *)
@@ -1312,6 +3444,15 @@ unsigned int ask_fentry(unsigned int);
  */
 unsigned int ask_dentry(unsigned int,bootsec_tp *);
 
+/**
+ *  @fn       ask_direntry(unsigned int,unsigned int)
+ *  @param    old
+ *  @param    entries
+ *  @return   unsigned int
+ *	@brief    Enter a direntry of a directory with this number of entries
+ */
+unsigned int ask_direntry(unsigned int,unsigned int);
+
 /**
  *  @fn       change_logdrive
  *  @return   char